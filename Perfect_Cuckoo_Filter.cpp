@@ -6,6 +6,28 @@
 #include <cstdint>
 #include <algorithm>
 #include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "src/pcf_snapshot.h"
+#include "src/pcf_table.h"
+#include "src/utxo_codec.h"
+#include "src/utxo_csv.h"
+#include "src/utxo_protocol.h"
+#include "src/utxo_server.h"
+#include "src/utxo_stats.h"
+#include "src/utxo_wal.h"
+#include "src/value_slab.h"
+#include "src/hashers.h"
+#include "src/outpoint.h"
 
 using namespace std;
 
@@ -15,346 +37,569 @@ struct UTXOValue {
     uint64_t height;
     uint64_t amount;
     string script;
-    string address;
 
     UTXOValue() : coinbase(false), height(0), amount(0) {}
-    UTXOValue(bool cb, uint64_t h, uint64_t amt, const string& scr, const string& addr)
-        : coinbase(cb), height(h), amount(amt), script(scr), address(addr) {}
+    UTXOValue(bool cb, uint64_t h, uint64_t amt, const string& scr)
+        : coinbase(cb), height(h), amount(amt), script(scr) {}
 };
 
 // Perfect Cuckoo Filter Implementation
+template <typename Hasher = Crc32Hasher>
 class UTXOManager {
 private:
-    struct BucketEntry {
-        uint32_t fingerprint; // 13-bit fingerprint
-        bool selector_bit;    // 0 for primary, 1 for alternate bucket
-        UTXOValue value;     // Stored value
-        BucketEntry() : fingerprint(0), selector_bit(false) {}
-        BucketEntry(uint32_t fp, bool sb, const UTXOValue& val)
-            : fingerprint(fp), selector_bit(sb), value(val) {}
-    };
-
     static const size_t BUCKET_SIZE = 4;
-    static const size_t NUM_BUCKETS = 1 << 19; // 524,288 buckets
-    static const size_t MAX_RELOCATIONS = 500; // Increased for robustness
+    static const size_t NUM_BUCKETS = 1 << 19; // 524,288 buckets (initial)
     static const uint32_t UNIVERSE_BITS = 32;  // 32-bit universe
+    static const uint32_t BUCKET_BITS = 19;
     static const uint32_t FINGERPRINT_BITS = 13; // 32 - 19 = 13 bits
-    vector<vector<BucketEntry>> buckets;
-
-    // CRC32 (bijective hash function for 32-bit universe)
-    uint32_t crc32_hash(const string& key) const {
-        const uint32_t polynomial = 0xEDB88320; // Standard CRC32 polynomial
-        uint32_t crc = 0xFFFFFFFF;
-
-        for (char c : key) {
-            crc ^= static_cast<uint8_t>(c);
-            for (int i = 0; i < 8; i++) {
-                crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
-            }
+    Hasher hasher;             // 32-bit hash; bucket = low bits, fingerprint = high bits
+    unique_ptr<SnapshotFile> snapshot; // mapped snapshot the table and slab run on, if loaded
+    PcfTable<uint32_t> table;  // Packed tags + slab index per slot, kicks and online growth
+    ValueSlab values;          // Compact encoded values (utxo_codec.h), by slab index
+    string encoded;            // Encoding scratch buffer
+    unique_ptr<WriteAheadLog> wal; // changes since the snapshot, if a log is open
+    string snapshot_path;      // snapshot last loaded or saved, target of compaction
+    uint64_t best_height = 0;  // recorded in snapshots
+    uint64_t log_sequence = 0; // last log record reflected in the table
+    pid_t compaction_pid = -1; // child writing a snapshot, if any
+    mutable UtxoStats stats;   // hot-path event counters (src/utxo_stats.h)
+
+    static const size_t COMPACT_AFTER_RECORDS = 100000;
+    static const size_t MULTI_GET_DISTANCE = 16;
+    static const size_t BATCH_PREFETCH_DISTANCE = 8;
+    vector<uint32_t> batch_hashes; // add_encoded_batch() / remove_batch() scratch
+
+    PcfTable<uint32_t>::InsertResult add_hashed(uint32_t h, string_view value) {
+        if (table.contains(h)) {
+            stats.add(UtxoStats::DUPLICATES);
+            return PcfTable<uint32_t>::DUPLICATE;
         }
-        return ~crc; // Finalize CRC
-    }
-
-    // Compute bucket and fingerprint
-    void get_bucket_fingerprint(const string& key, uint32_t& bucket, uint32_t& fingerprint) const {
-        uint32_t h = crc32_hash(key);
-        bucket = h & ((1 << 19) - 1); // Lower 19 bits for bucket
-        fingerprint = (h >> 19) & ((1 << FINGERPRINT_BITS) - 1); // Upper 13 bits
-    }
-
-    // Compute alternate bucket
-    uint32_t get_alt_bucket(uint32_t bucket, uint32_t fingerprint) const {
-        uint32_t fp_hash = fingerprint * 0xCC9E2D51;
-        return bucket ^ (fp_hash & ((1 << 19) - 1));
+        uint32_t index = values.add(value);
+        if (index == ValueSlab::NO_INDEX) {
+            stats.add(UtxoStats::INSERT_FAILURES);
+            return PcfTable<uint32_t>::FULL;
+        }
+        PcfTable<uint32_t>::InsertResult result = table.insert(h, index);
+        if (result == PcfTable<uint32_t>::INSERTED) {
+            stats.add(UtxoStats::INSERTS);
+            if (wal) log_sequence = wal->append_add(h, value);
+        } else {
+            values.release(index);
+            stats.add(UtxoStats::INSERT_FAILURES);
+        }
+        return result;
     }
 
-    // Relocation logic for insertion
-    bool relocate(uint32_t bucket, uint32_t fingerprint, const UTXOValue& value, size_t depth) {
-        if (depth > MAX_RELOCATIONS) {
+    bool remove_hashed(uint32_t h) {
+        uint32_t index;
+        if (!table.erase(h, index)) {
+            stats.add(UtxoStats::REMOVE_MISSES);
             return false;
         }
+        stats.add(UtxoStats::REMOVES);
+        values.release(index);
+        if (wal) log_sequence = wal->append_remove(h);
+        return true;
+    }
 
-        uint32_t alt_bucket = get_alt_bucket(bucket, fingerprint);
-        if (buckets[alt_bucket].size() < BUCKET_SIZE) {
-            buckets[alt_bucket].push_back({fingerprint, true, value});
-            return true;
-        }
+    void hash_batch(const OutPoint* keys, size_t n) {
+        batch_hashes.resize(n);
+        for (size_t i = 0; i < n; i++) batch_hashes[i] = hash_key(keys[i]);
+        for (size_t i = 0; i < n && i < BATCH_PREFETCH_DISTANCE; i++) table.prefetch(batch_hashes[i]);
+    }
 
-        size_t evict_idx = rand() % buckets[alt_bucket].size();
-        BucketEntry evicted = buckets[alt_bucket][evict_idx];
-        buckets[alt_bucket][evict_idx] = {fingerprint, true, value};
+public:
+    uint32_t hash_key(const OutPoint& key) const { return hasher(&key, sizeof(key)); }
 
-        uint32_t new_bucket = get_alt_bucket(alt_bucket, evicted.fingerprint);
-        if (evicted.selector_bit) {
-            new_bucket = alt_bucket ^ (evicted.fingerprint * 0xCC9E2D51 & ((1 << 19) - 1));
-        }
+    explicit UTXOManager(size_t max_path_length = CuckooInserter::DEFAULT_MAX_PATH_LENGTH)
+        : table(BUCKET_BITS, BUCKET_SIZE, FINGERPRINT_BITS, max_path_length) {}
 
-        if (buckets[new_bucket].size() < BUCKET_SIZE) {
-            buckets[new_bucket].push_back(evicted);
-            return true;
-        }
+    // Double the table (one fingerprint bit per doubling) instead of failing
+    // inserts once the load factor reaches max_load
+    void enable_growth(double max_load = PcfTable<uint32_t>::DEFAULT_MAX_LOAD) { table.enable_growth(max_load); }
 
-        return relocate(new_bucket, evicted.fingerprint, evicted.value, depth + 1);
+    bool add_utxo(const OutPoint& key, const UTXOValue& value) {
+        return add_utxo(key, value.coinbase, value.height, value.amount, value.script);
     }
 
-public:
-    UTXOManager() : buckets(NUM_BUCKETS) {
-        srand(time(nullptr));
+    // Field-wise insert, so loaders can pass views without building a UTXOValue
+    bool add_utxo(const OutPoint& key, bool coinbase, uint64_t height, uint64_t amount, string_view script) {
+        encoded.clear();
+        encode_utxo(coinbase, height, amount, script, encoded);
+        return add_hashed(hash_key(key), encoded) == PcfTable<uint32_t>::INSERTED;
     }
 
-    bool add_utxo(const string& key, const UTXOValue& value) {
-        uint32_t bucket, fingerprint;
-        get_bucket_fingerprint(key, bucket, fingerprint);
+    // Insert of a value already in the utxo_codec encoding
+    PcfTable<uint32_t>::InsertResult add_encoded(const OutPoint& key, string_view value) {
+        return add_hashed(hash_key(key), value);
+    }
 
-        // Check for duplicates using fingerprint and selector bit
-        for (const auto& entry : buckets[bucket]) {
-            if (entry.fingerprint == fingerprint && entry.selector_bit == false) {
-                cerr << "UTXO with fingerprint " << fingerprint << " already exists in primary bucket\n";
-                return false;
-            }
+    // Bulk insert of pre-hashed, pre-encoded values on `threads` threads
+    // (see PcfTable::insert_parallel). Counts duplicates and failures as
+    // add_utxo() does; returns how many were added. Not logged: bulk loads
+    // are followed by a snapshot.
+    size_t add_encoded_parallel(const uint32_t* hashes, const string_view* encoded_values, size_t n, size_t threads) {
+        vector<uint32_t> indexes(n);
+        size_t stored = 0;
+        for (size_t i = 0; i < n; i++) {
+            indexes[i] = values.add(encoded_values[i]);
+            stored += indexes[i] != ValueSlab::NO_INDEX;
         }
-        uint32_t alt_bucket = get_alt_bucket(bucket, fingerprint);
-        for (const auto& entry : buckets[alt_bucket]) {
-            if (entry.fingerprint == fingerprint && entry.selector_bit == true) {
-                cerr << "UTXO with fingerprint " << fingerprint << " already exists in alternate bucket\n";
-                return false;
+        vector<PcfTable<uint32_t>::InsertResult> results(n, PcfTable<uint32_t>::FULL);
+        if (stored == n) {
+            table.insert_parallel(hashes, indexes.data(), n, threads, results.data());
+        } else {
+            // Values the slab refused fail without reaching the table
+            vector<size_t> positions;
+            vector<uint32_t> kept_hashes, kept_indexes;
+            for (size_t i = 0; i < n; i++) {
+                if (indexes[i] == ValueSlab::NO_INDEX) continue;
+                positions.push_back(i);
+                kept_hashes.push_back(hashes[i]);
+                kept_indexes.push_back(indexes[i]);
             }
+            vector<PcfTable<uint32_t>::InsertResult> kept_results(stored);
+            table.insert_parallel(kept_hashes.data(), kept_indexes.data(), stored, threads, kept_results.data());
+            for (size_t k = 0; k < stored; k++) results[positions[k]] = kept_results[k];
         }
 
-        if (buckets[bucket].size() < BUCKET_SIZE) {
-            buckets[bucket].push_back({fingerprint, false, value});
-            return true;
+        size_t added = 0, duplicates = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (results[i] == PcfTable<uint32_t>::INSERTED) {
+                added++;
+                continue;
+            }
+            if (indexes[i] != ValueSlab::NO_INDEX) values.release(indexes[i]);
+            if (results[i] == PcfTable<uint32_t>::DUPLICATE) duplicates++;
         }
+        stats.add(UtxoStats::INSERTS, added);
+        stats.add(UtxoStats::DUPLICATES, duplicates);
+        stats.add(UtxoStats::INSERT_FAILURES, n - added - duplicates);
+        return added;
+    }
 
-        if (buckets[alt_bucket].size() < BUCKET_SIZE) {
-            buckets[alt_bucket].push_back({fingerprint, true, value});
-            return true;
+    // add_encoded() / remove_utxo() over a batch, in order, with the
+    // buckets of the key BATCH_PREFETCH_DISTANCE ahead already requested
+    void add_encoded_batch(const OutPoint* keys, const string_view* encoded_values, size_t n,
+                           PcfTable<uint32_t>::InsertResult* results) {
+        hash_batch(keys, n);
+        for (size_t i = 0; i < n; i++) {
+            if (i + BATCH_PREFETCH_DISTANCE < n) table.prefetch(batch_hashes[i + BATCH_PREFETCH_DISTANCE]);
+            results[i] = add_hashed(batch_hashes[i], encoded_values[i]);
         }
+    }
 
-        if (relocate(bucket, fingerprint, value, 0)) {
-            return true;
+    void remove_batch(const OutPoint* keys, size_t n, bool* removed) {
+        hash_batch(keys, n);
+        for (size_t i = 0; i < n; i++) {
+            if (i + BATCH_PREFETCH_DISTANCE < n) table.prefetch(batch_hashes[i + BATCH_PREFETCH_DISTANCE]);
+            removed[i] = remove_hashed(batch_hashes[i]);
         }
-
-        cerr << "Failed to insert UTXO with fingerprint " << fingerprint << " - relocation failed\n";
-        return false;
     }
 
-    const UTXOValue* get_utxo(const string& key) const {
-        uint32_t bucket, fingerprint;
-        get_bucket_fingerprint(key, bucket, fingerprint);
-
-        for (const auto& entry : buckets[bucket]) {
-            if (entry.fingerprint == fingerprint && entry.selector_bit == false) {
-                return &entry.value;
+    // Encoded values of n keys (empty if absent), in order. Pipelined as
+    // a ring: buckets are prefetched MULTI_GET_DISTANCE keys ahead and
+    // probed half way, which also prefetches the value. The views stay
+    // valid until the next change.
+    void multi_get(const OutPoint* keys, size_t n, string_view* out) const {
+        const size_t probe_ahead = MULTI_GET_DISTANCE / 2;
+        uint32_t hashes[MULTI_GET_DISTANCE];
+        const uint32_t* found[MULTI_GET_DISTANCE];
+        size_t alternate_hits = 0, misses = 0;
+        auto ring = [](size_t i) { return i % MULTI_GET_DISTANCE; };
+        for (size_t i = 0; i < n + MULTI_GET_DISTANCE; i++) {
+            if (i < n) {
+                hashes[ring(i)] = hash_key(keys[i]);
+                table.prefetch(hashes[ring(i)]);
+            }
+            if (i >= probe_ahead && i - probe_ahead < n) {
+                size_t p = i - probe_ahead;
+                bool alternate;
+                found[ring(p)] = table.find(hashes[ring(p)], alternate);
+                if (found[ring(p)]) {
+                    values.prefetch(*found[ring(p)]);
+                    alternate_hits += alternate;
+                } else {
+                    misses++;
+                }
+            }
+            if (i >= MULTI_GET_DISTANCE && i - MULTI_GET_DISTANCE < n) {
+                size_t d = i - MULTI_GET_DISTANCE;
+                out[d] = found[ring(d)] ? values.get(*found[ring(d)]) : string_view();
             }
         }
+        stats.add(UtxoStats::LOOKUPS, n);
+        stats.add(UtxoStats::LOOKUP_MISSES, misses);
+        stats.add(UtxoStats::ALTERNATE_HITS, alternate_hits);
+        stats.add(UtxoStats::PRIMARY_HITS, n - misses - alternate_hits);
+    }
 
-        uint32_t alt_bucket = get_alt_bucket(bucket, fingerprint);
-        for (const auto& entry : buckets[alt_bucket]) {
-            if (entry.fingerprint == fingerprint && entry.selector_bit == true) {
-                return &entry.value;
-            }
+    ValueRef get_utxo(const OutPoint& key) const {
+        bool alternate;
+        const uint32_t* index = table.find(hash_key(key), alternate);
+        stats.add(UtxoStats::LOOKUPS);
+        if (!index) {
+            stats.add(UtxoStats::LOOKUP_MISSES);
+            return ValueRef();
         }
+        stats.add(alternate ? UtxoStats::ALTERNATE_HITS : UtxoStats::PRIMARY_HITS);
+        return ValueRef(values.get(*index));
+    }
+
+    bool remove_utxo(const OutPoint& key) { return remove_hashed(hash_key(key)); }
 
-        return nullptr;
+    // Text-key overloads: parse "txid:index" and forward to the binary API
+    bool add_utxo(const string& key, const UTXOValue& value) {
+        OutPoint outpoint;
+        if (!parse_outpoint(key, outpoint)) {
+            stats.add(UtxoStats::INVALID_KEYS);
+            return false;
+        }
+        return add_utxo(outpoint, value);
+    }
+
+    ValueRef get_utxo(const string& key) const {
+        OutPoint outpoint;
+        if (parse_outpoint(key, outpoint)) return get_utxo(outpoint);
+        stats.add(UtxoStats::INVALID_KEYS);
+        return ValueRef();
     }
 
     bool remove_utxo(const string& key) {
-        uint32_t bucket, fingerprint;
-        get_bucket_fingerprint(key, bucket, fingerprint);
+        OutPoint outpoint;
+        if (!parse_outpoint(key, outpoint)) {
+            stats.add(UtxoStats::INVALID_KEYS);
+            return false;
+        }
+        return remove_utxo(outpoint);
+    }
 
-        auto& primary = buckets[bucket];
-        for (auto it = primary.begin(); it != primary.end(); ++it) {
-            if (it->fingerprint == fingerprint && !it->selector_bit) {
-                primary.erase(it);
-                return true;
-            }
+    // Writes the filter and values to `path` (see src/pcf_snapshot.h)
+    bool save_snapshot(const string& path, uint64_t height) {
+        table.finish_migration();
+        string error;
+        if (!write_snapshot(path, table, values, Hasher::name(), height, log_sequence, error)) {
+            cerr << "Failed to write snapshot " << error << "\n";
+            return false;
+        }
+        snapshot_path = path;
+        best_height = height;
+        return true;
+    }
+
+    // Replaces the contents with a mapped snapshot, used in place; keeps
+    // the growth setting
+    bool load_snapshot(const string& path, uint64_t& height) {
+        unique_ptr<SnapshotFile> file(new SnapshotFile());
+        string error;
+        if (!file->open(path, Hasher::name(), error)) {
+            cerr << "Cannot load snapshot " << error << "\n";
+            return false;
         }
+        const SnapshotHeader& header = file->header();
+        bool growth = table.growth_enabled();
+        double max_load = table.max_load();
+        size_t buckets_per_step = table.buckets_per_step();
+        table = PcfTable<uint32_t>(header.bucket_bits, header.slots_per_bucket, header.fingerprint_bits,
+                                   file->bucket_words(), file->payloads(), header.entries, header.alternate_entries,
+                                   header.block_bits, table.max_path_length());
+        if (growth) table.enable_growth(max_load, buckets_per_step);
+        values = ValueSlab(file->records(), header.record_count, file->arena(), header.arena_bytes,
+                           header.live_values, header.dead_bytes);
+        height = best_height = header.best_height;
+        log_sequence = header.log_sequence;
+        snapshot_path = path;
+        snapshot = move(file); // frees the previous mapping, if any, now nothing uses it
+        return true;
+    }
 
-        uint32_t alt_bucket = get_alt_bucket(bucket, fingerprint);
-        auto& alternate = buckets[alt_bucket];
-        for (auto it = alternate.begin(); it != alternate.end(); ++it) {
-            if (it->fingerprint == fingerprint && it->selector_bit) {
-                alternate.erase(it);
+    // Replays the write-ahead log at `path` (and a leftover "<path>.old")
+    // past the loaded snapshot, then keeps logging every add and remove to
+    // it. Returns the number of records replayed, or -1 on error; records
+    // that no longer fit (value slab or table full) are reported and skipped.
+    long open_log(const string& path) {
+        string error;
+        size_t replayed = 0;
+        WriteAheadLog::ReplayResult old_result, result;
+        auto apply = [this](WriteAheadLog::RecordType type, uint64_t sequence, uint32_t h, string_view value) {
+            log_sequence = sequence;
+            uint32_t index;
+            if (type == WriteAheadLog::REMOVE) {
+                if (table.erase(h, index)) values.release(index);
                 return true;
             }
+            if (table.contains(h)) return true;
+            index = values.add(value);
+            if (index == ValueSlab::NO_INDEX) return false;
+            if (table.insert(h, index) != PcfTable<uint32_t>::INSERTED) {
+                values.release(index);
+                return false;
+            }
+            return true;
+        };
+        if (!WriteAheadLog::replay(WriteAheadLog::old_path(path), log_sequence, apply, old_result, error)) {
+            cerr << "Cannot replay log " << error << "\n";
+            return -1;
+        }
+        replayed += old_result.applied;
+        if (!WriteAheadLog::replay(path, log_sequence, apply, result, error)) {
+            cerr << "Cannot replay log " << error << "\n";
+            return -1;
+        }
+        replayed += result.applied;
+        if (old_result.refused + result.refused > 0) {
+            cerr << "Warning: " << old_result.refused + result.refused << " logged adds from " << path
+                 << " could not be applied\n";
         }
 
-        cerr << "UTXO with fingerprint " << fingerprint << " not found\n";
-        return false;
+        unique_ptr<WriteAheadLog> log(new WriteAheadLog());
+        if (!log->open(path, result.valid_bytes, old_result.valid_bytes, log_sequence + 1, error)) {
+            cerr << "Cannot open log " << error << "\n";
+            return -1;
+        }
+        wal = move(log);
+        return static_cast<long>(replayed);
     }
 
-    size_t count() const {
-        size_t total = 0;
-        for (const auto& bucket : buckets) {
-            total += bucket.size();
+    // Folds the log into a new snapshot without stopping: the log is
+    // rotated and a forked child writes the snapshot from its copy-on-write
+    // image of the table. poll_compaction() deletes the rotated log once
+    // the child has succeeded.
+    bool start_compaction() {
+        if (!wal || snapshot_path.empty() || compaction_pid > 0) return false;
+        string error;
+        if (!wal->rotate(error)) {
+            cerr << "Cannot rotate log " << error << "\n";
+            return false;
         }
-        return total;
+        table.finish_migration();
+        pid_t pid = fork();
+        if (pid < 0) {
+            cerr << "Cannot start compaction: " << strerror(errno) << "\n";
+            return false;
+        }
+        if (pid == 0) {
+            bool ok = write_snapshot(snapshot_path, table, values, Hasher::name(), best_height, log_sequence, error);
+            if (!ok) cerr << "Failed to write snapshot " << error << "\n";
+            _exit(ok ? 0 : 1);
+        }
+        compaction_pid = pid;
+        return true;
+    }
+
+    // Reaps a finished compaction (waiting for it if `wait`); true once
+    // none is running
+    bool poll_compaction(bool wait = false) {
+        if (compaction_pid <= 0) return true;
+        int status;
+        pid_t done = waitpid(compaction_pid, &status, wait ? 0 : WNOHANG);
+        if (done == 0) return false;
+        if (done == compaction_pid && WIFEXITED(status) && WEXITSTATUS(status) == 0) wal->finish_rotation();
+        compaction_pid = -1;
+        return true;
+    }
+
+    // Blocks until every change logged so far is on disk (one group commit
+    // for however many there are); true at once without a log or changes
+    bool sync_log() { return !wal || wal->flush(); }
+
+    // Starts a compaction once enough records have been logged since the last
+    void maybe_compact() {
+        if (poll_compaction() && wal && wal->records_since_rotation() >= COMPACT_AFTER_RECORDS) start_compaction();
+    }
+
+    const KickHistogram& kick_histogram() const { return table.kick_histogram(); }
+
+    size_t count() const { return table.count(); }
+
+    // Counters plus the table's running figures, all O(1) reads
+    UtxoStatsSnapshot stats_snapshot() const {
+        UtxoStatsSnapshot snapshot;
+        snapshot.read_counters(stats);
+        snapshot.entries = table.count();
+        snapshot.alternate_entries = table.alternate_entries();
+        snapshot.capacity = table.capacity();
+        snapshot.load_factor = table.load_factor();
+        snapshot.kicks = table.kick_histogram();
+        return snapshot;
     }
 
     void display_stats() const {
-        size_t primary = 0, secondary = 0, empty = 0;
-        for (const auto& bucket : buckets) {
-            if (bucket.empty()) empty++;
-            for (const auto& entry : bucket) {
-                entry.selector_bit ? secondary++ : primary++;
-            }
-        }
+        size_t primary, secondary, empty;
+        table.tag_counts(primary, secondary, empty);
         cout << "\n=== UTXO Manager Statistics ===\n"
              << "Total UTXOs: " << count() << "\n"
              << "Primary bucket entries: " << primary << "\n"
              << "Secondary bucket entries: " << secondary << "\n"
              << "Empty buckets: " << empty << " ("
-             << fixed << setprecision(1) << (100.0 * empty / NUM_BUCKETS) << "%)\n"
-             << "Load factor: " << (100.0 * (primary + secondary) / (NUM_BUCKETS * BUCKET_SIZE)) << "%\n";
+             << fixed << setprecision(1) << (100.0 * empty / table.bucket_count()) << "%)\n"
+             << "Load factor: " << (100.0 * table.load_factor()) << "%\n"
+             << "Buckets: " << table.bucket_count() << " x " << table.slots_per_bucket()
+             << (table.migrating() ? " (growing)" : "") << "\n"
+             << "Filter memory: " << (table.table_bytes() / (1024.0 * 1024.0)) << " MB ("
+             << table.tag_bits() << " bits per slot)\n"
+             << "Value store: " << (values.memory_bytes() / (1024.0 * 1024.0)) << " MB ("
+             << fixed << setprecision(1) << (values.size() ? double(values.arena_bytes()) / values.size() : 0.0)
+             << " encoded bytes per UTXO)\n";
+        if (snapshot) cout << "Mapped snapshot: " << (snapshot->file_bytes() / (1024.0 * 1024.0)) << " MB\n";
+        table.kick_histogram().print(cout);
+        UtxoStatsSnapshot counters = stats_snapshot();
+        cout << "Inserts: " << counters[UtxoStats::INSERTS] << " (" << counters[UtxoStats::DUPLICATES]
+             << " duplicates, " << counters[UtxoStats::INSERT_FAILURES] << " failed)"
+             << " | Removes: " << counters[UtxoStats::REMOVES] << " (" << counters[UtxoStats::REMOVE_MISSES]
+             << " not found) | Invalid keys: " << counters[UtxoStats::INVALID_KEYS] << "\n"
+             << "Lookups: " << counters[UtxoStats::LOOKUPS] << " | Negative: "
+             << (100.0 * counters.negative_lookup_rate()) << "% | Alternate-bucket hits: "
+             << (100.0 * counters.alternate_hit_ratio()) << "%\n";
     }
 };
 
-// Enhanced CSV Parser
-vector<string> split_utxo_line(const string& line, char delimiter) {
-    vector<string> tokens;
-    string token;
-    istringstream iss(line);
-    bool in_quotes = false;
-    char current_quote = '\0';
-
-    for (char c : line) {
-        if ((c == '\'' || c == '"') && !in_quotes) {
-            in_quotes = true;
-            current_quote = c;
-            token += c;
-        } else if (c == current_quote && in_quotes) {
-            in_quotes = false;
-            token += c;
-        } else if (c == delimiter && !in_quotes) {
-            tokens.push_back(token);
-            token.clear();
-        } else {
-            token += c;
-        }
-    }
-    if (!token.empty()) {
-        tokens.push_back(token);
-    }
-    return tokens;
-}
+// One chunk of the dump after the parse stage
+struct ParsedChunk {
+    vector<uint32_t> hashes;
+    vector<string_view> values; // encodings, pointing into `encoded`
+    string encoded;
+    size_t skipped = 0;
+    uint64_t max_height = 0;
+    string log;    // diagnostics for cout, in line order
+    string errors; // diagnostics for cerr, in line order
+};
 
-vector<string> try_split_utxo_line(const string& line) {
-    for (char delim : {'\t', ',', ';'}) {
-        auto tokens = split_utxo_line(line, delim);
-        if (tokens.size() >= 6) {
-            return tokens;
+// Parse stage: split, validate, hash and encode every row of one chunk
+void parse_chunk(const UTXOManager<>& manager, string_view text, size_t lines_before, char delimiter,
+                 ParsedChunk& out) {
+    UtxoCsvReader reader;
+    reader.open_view(text, lines_before, delimiter);
+    ostringstream log, errors;
+    vector<size_t> ends;
+    CsvRow row;
+    while (reader.next(row)) {
+        if (row.line.empty()) {
+            out.skipped++;
+            continue;
+        }
+        if (row.line_num < 5 || (row.line_num >= 15096 && row.line_num <= 15125)) {
+            log << "\nRaw line " << row.line_num << ": [" << row.line << "]\n"
+                << "Line " << row.line_num << " parsed as " << row.num_fields << " columns:\n";
+            for (size_t i = 0; i < row.num_fields && i < CsvRow::MAX_FIELDS; i++) {
+                log << "  Column " << i << ": [" << row.fields[i] << "]\n";
+            }
+        }
+        if (row.num_fields < UtxoCsvReader::UTXO_FIELDS) {
+            errors << "Line " << row.line_num << ": Only " << row.num_fields << " columns found\n";
+            out.skipped++;
+            continue;
+        }
+        UtxoRecord record;
+        OutPoint key;
+        if (!parse_utxo_row(row, record)) {
+            errors << "Line " << row.line_num << ": Error - malformed height or amount\n";
+            out.skipped++;
+        } else if (!parse_outpoint(record.key, key)) {
+            errors << "Invalid txid:index key " << record.key << "\n";
+            out.skipped++;
+        } else {
+            out.hashes.push_back(manager.hash_key(key));
+            out.max_height = max(out.max_height, record.height);
+            encode_utxo(record.coinbase, record.height, record.amount, record.script, out.encoded);
+            ends.push_back(out.encoded.size());
         }
     }
-    vector<string> tokens;
-    istringstream iss(line);
-    string token;
-    while (iss >> token) {
-        tokens.push_back(token);
+    // Views are taken once `encoded` has stopped growing
+    for (size_t i = 0, begin = 0; i < ends.size(); begin = ends[i++]) {
+        out.values.push_back(string_view(out.encoded).substr(begin, ends[i] - begin));
     }
-    return tokens;
+    out.log = log.str();
+    out.errors = errors.str();
 }
 
-UTXOValue parse_utxo_data(const vector<string>& tokens) {
-    UTXOValue utxo;
-    try {
-        if (tokens.size() < 6) throw runtime_error("Not enough columns");
-        utxo.coinbase = tokens[1] == "1";
-        utxo.height = stoull(tokens[2]);
-        utxo.amount = stoull(tokens[3]);
-        utxo.script = tokens[4];
-        utxo.address = tokens[5];
-    } catch (const exception& e) {
-        cerr << "Error parsing UTXO data: " << e.what() << endl;
-        cerr << "Tokens received: ";
-        for (const auto& t : tokens) cerr << "[" << t << "] ";
-        cerr << endl;
-    }
-    return utxo;
+// Runs fn(i) for i in [0, n) on up to `threads` threads
+template <typename Fn>
+void run_parallel(size_t n, size_t threads, Fn fn) {
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i; (i = next.fetch_add(1)) < n;) fn(i);
+    };
+    vector<thread> pool;
+    for (size_t t = 1; t < threads && t < n; t++) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
 }
 
-void load_utxo_dataset(UTXOManager& manager, const string& filename) {
-    ifstream file(filename);
-    if (!file) {
+// Staged bulk load: the mapped dump is cut into line-aligned chunks; per
+// batch of chunks, parser threads split, hash and encode the rows, then the
+// manager inserts the batch with one worker per bucket partition. Results
+// and diagnostics are the same as a line-by-line load.
+// Returns the highest block height in the dump
+uint64_t load_utxo_dataset(UTXOManager<>& manager, const string& filename,
+                           size_t threads = max(1u, thread::hardware_concurrency())) {
+    const size_t CHUNK_BYTES = 16 << 20;
+    UtxoCsvReader reader;
+    if (!reader.open(filename)) {
         cerr << "Error: Cannot open file " << filename << endl;
-        return;
-    }
-    string line;
-    size_t line_num = 0, loaded = 0, skipped = 0;
-    if (getline(file, line)) {
-        if (line.find("txid:index") != string::npos || line.find("coinbase") != string::npos) {
-            cout << "Skipping header row\n";
-        } else {
-            if (line_num < 5) {
-                cout << "\nRaw line " << line_num + 1 << ": [" << line << "]\n";
-            }
-            vector<string> tokens = try_split_utxo_line(line);
-            if (line_num < 5) {
-                cout << "Line " << line_num + 1 << " parsed as " << tokens.size() << " columns:\n";
-                for (size_t i = 0; i < tokens.size(); i++) {
-                    cout << "  Column " << i << ": [" << tokens[i] << "]\n";
-                }
-            }
-            if (tokens.size() >= 6) {
-                UTXOValue value = parse_utxo_data(tokens);
-                if (manager.add_utxo(tokens[0], value)) loaded++;
-                else skipped++;
-            } else {
-                cerr << "Line " << line_num + 1 << ": Only " << tokens.size() << " columns found\n";
-                skipped++;
-            }
-        }
-        line_num++;
+        return 0;
     }
-    while (getline(file, line)) {
-        line_num++;
-        if (line.empty()) {
-            skipped++;
-            continue;
-        }
-        if (line_num < 5 || (line_num >= 15096 && line_num <= 15125)) {
-            cout << "\nRaw line " << line_num << ": [" << line << "]\n";
-        }
-        vector<string> tokens = try_split_utxo_line(line);
-        if (line_num < 5 || (line_num >= 15096 && line_num <= 15125)) {
-            cout << "Line " << line_num << " parsed as " << tokens.size() << " columns:\n";
-            for (size_t i = 0; i < tokens.size(); i++) {
-                cout << "  Column " << i << ": [" << tokens[i] << "]\n";
-            }
-        }
-        if (tokens.size() < 6) {
-            cerr << "Line " << line_num << ": Only " << tokens.size() << " columns found\n";
-            skipped++;
-            continue;
-        }
-        try {
-            UTXOValue value = parse_utxo_data(tokens);
-            if (manager.add_utxo(tokens[0], value)) loaded++;
-            else skipped++;
-        } catch (const exception& e) {
-            cerr << "Line " << line_num << ": Error - " << e.what() << "\n";
-            skipped++;
+    if (reader.header_skipped()) cout << "Skipping header row\n";
+
+    string_view text = reader.remaining();
+    char delimiter = reader.peek_delimiter();
+    vector<string_view> chunks = split_at_lines(text, max(threads, text.size() / CHUNK_BYTES + 1));
+
+    // Line numbers of each chunk's first line
+    vector<size_t> lines_before(chunks.size() + 1, reader.lines_read());
+    vector<size_t> chunk_lines(chunks.size());
+    run_parallel(chunks.size(), threads, [&](size_t i) { chunk_lines[i] = count_lines(chunks[i]); });
+    for (size_t i = 0; i < chunks.size(); i++) lines_before[i + 1] = lines_before[i] + chunk_lines[i];
+
+    size_t loaded = 0, skipped = 0;
+    uint64_t best_height = 0;
+    for (size_t batch = 0; batch < chunks.size(); batch += threads) {
+        size_t batch_size = min(threads, chunks.size() - batch);
+        vector<ParsedChunk> parsed(batch_size);
+        run_parallel(batch_size, threads, [&](size_t i) {
+            parse_chunk(manager, chunks[batch + i], lines_before[batch + i], delimiter, parsed[i]);
+        });
+
+        vector<uint32_t> hashes;
+        vector<string_view> values;
+        for (const ParsedChunk& chunk : parsed) {
+            cout << chunk.log;
+            cerr << chunk.errors;
+            skipped += chunk.skipped;
+            best_height = max(best_height, chunk.max_height);
+            hashes.insert(hashes.end(), chunk.hashes.begin(), chunk.hashes.end());
+            values.insert(values.end(), chunk.values.begin(), chunk.values.end());
         }
+        size_t added = manager.add_encoded_parallel(hashes.data(), values.data(), hashes.size(), threads);
+        loaded += added;
+        skipped += hashes.size() - added;
     }
+
     cout << "\n=== Loading Results ===\n"
-         << "Total lines processed: " << line_num << "\n"
+         << "Total lines processed: " << lines_before.back() << "\n"
          << "Successfully loaded:   " << loaded << "\n"
          << "Skipped:               " << skipped << "\n";
+    UtxoStatsSnapshot counters = manager.stats_snapshot();
+    if (counters[UtxoStats::DUPLICATES] || counters[UtxoStats::INSERT_FAILURES]) {
+        cout << "  of which duplicates: " << counters[UtxoStats::DUPLICATES]
+             << ", no eviction path: " << counters[UtxoStats::INSERT_FAILURES] << "\n";
+    }
+    return best_height;
 }
 
 // Interactive Interface
-void print_utxo_details(const string& key, const UTXOValue* utxo) {
+void print_utxo_details(const string& key, ValueRef utxo) {
     if (!utxo) {
         cout << "UTXO with key " << key << " not found\n";
         return;
     }
     cout << "\n=== UTXO Details ===\n"
          << "Key:      " << key << "\n"
-         << "Coinbase: " << (utxo->coinbase ? "Yes" : "No") << "\n"
-         << "Height:   " << utxo->height << "\n"
-         << "Amount:   " << utxo->amount << " satoshis\n"
-         << "Script:   " << utxo->script << "\n"
-         << "Address:  " << utxo->address << "\n\n";
+         << "Coinbase: " << (utxo.coinbase() ? "Yes" : "No") << "\n"
+         << "Height:   " << utxo.height() << "\n"
+         << "Amount:   " << utxo.amount() << " satoshis\n"
+         << "Script:   " << utxo.script() << "\n"
+         << "Address:  " << (utxo.script_type() >= 0 ? utxo.address() : "(non-standard script)") << "\n\n";
 }
 
 void show_menu() {
@@ -367,7 +612,7 @@ void show_menu() {
          << "Enter choice: ";
 }
 
-void run_interactive(UTXOManager& manager) {
+void run_interactive(UTXOManager<>& manager, StatsExporter& exporter) {
     string input;
     while (true) {
         show_menu();
@@ -380,7 +625,7 @@ void run_interactive(UTXOManager& manager) {
         }
         switch (input[0]) {
             case '1': {
-                const UTXOValue* utxo = manager.get_utxo(key);
+                ValueRef utxo = manager.get_utxo(key);
                 print_utxo_details(key, utxo);
                 break;
             }
@@ -397,16 +642,20 @@ void run_interactive(UTXOManager& manager) {
                 new_utxo.amount = stoull(input);
                 cout << "Script: ";
                 getline(cin, new_utxo.script);
-                cout << "Address: ";
-                getline(cin, new_utxo.address);
                 if (manager.add_utxo(key, new_utxo)) {
                     cout << "UTXO added successfully!\n";
+                } else if (manager.get_utxo(key)) {
+                    cout << "UTXO with key " << key << " already exists\n";
+                } else {
+                    cout << "Failed to add UTXO with key " << key << " (invalid key or no eviction path)\n";
                 }
                 break;
             }
             case '3': {
                 if (manager.remove_utxo(key)) {
                     cout << "UTXO removed successfully!\n";
+                } else {
+                    cout << "UTXO with key " << key << " not found\n";
                 }
                 break;
             }
@@ -417,15 +666,311 @@ void run_interactive(UTXOManager& manager) {
             default:
                 cout << "Invalid choice\n";
         }
+        manager.maybe_compact();
+        if (exporter.due()) exporter.write(manager.stats_snapshot());
+    }
+    manager.poll_compaction(true);
+}
+
+// Answers src/utxo_protocol.h requests from one manager, on the server's
+// thread: GET batches go through multi_get(), ADD and DEL through the
+// prefetching batch paths, and every request's service time goes into
+// the latency histogram exported with the stats. commit() makes the
+// logged ADD and DEL records of a wakeup durable before they are answered.
+class UtxoService {
+public:
+    UtxoService(UTXOManager<>& manager, StatsExporter& exporter) : manager(manager), exporter(exporter) {}
+
+    void handle(const FrameHeader& request, string_view body, string& out) {
+        auto start = chrono::steady_clock::now();
+        FrameHeader response = request;
+        response.status = FrameHeader::OK;
+        size_t frame = response.begin_frame(out);
+        bool ok = false;
+        switch (static_cast<UtxoOp>(request.op)) {
+            case UtxoOp::GET: ok = get(request.count, body, out); break;
+            case UtxoOp::ADD: ok = add(request.count, body, out); break;
+            case UtxoOp::DEL: ok = remove(request.count, body, out); break;
+            case UtxoOp::STATS: ok = request.count == 0 && body.empty() && stats(out); break;
+        }
+        if (!ok || out.size() - frame - FrameHeader::SIZE > FrameHeader::MAX_BODY_BYTES) {
+            out.resize(frame);
+            response.status = ok ? FrameHeader::TOO_LARGE : FrameHeader::BAD_REQUEST;
+            response.count = 0;
+            frame = response.begin_frame(out);
+        }
+        FrameHeader::finish_frame(out, frame);
+        latency.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+    }
+
+    bool commit() { return manager.sync_log(); }
+
+    void idle() {
+        manager.maybe_compact();
+        if (exporter.due()) exporter.write(stats_snapshot());
+    }
+
+    UtxoStatsSnapshot stats_snapshot() const {
+        UtxoStatsSnapshot snapshot = manager.stats_snapshot();
+        snapshot.read_latency(latency);
+        return snapshot;
+    }
+
+private:
+    bool read_keys(uint32_t count, string_view body) {
+        if (body.size() != size_t(count) * sizeof(OutPoint)) return false;
+        keys.resize(count);
+        memcpy(keys.data(), body.data(), body.size());
+        return true;
+    }
+
+    bool get(uint32_t count, string_view body, string& out) {
+        if (!read_keys(count, body)) return false;
+        found.resize(count);
+        manager.multi_get(keys.data(), count, found.data());
+        for (string_view value : found) {
+            append_pod(out, static_cast<uint32_t>(value.size()));
+            out.append(value.data(), value.size());
+        }
+        return true;
+    }
+
+    bool add(uint32_t count, string_view body, string& out) {
+        BodyReader reader(body);
+        keys.resize(count);
+        found.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t length;
+            if (!reader.read(keys[i]) || !reader.read(length) || !reader.read_bytes(length, found[i]) || !valid_utxo_encoding(found[i])) {
+                return false;
+            }
+        }
+        if (!reader.done()) return false;
+        inserted.resize(count);
+        manager.add_encoded_batch(keys.data(), found.data(), count, inserted.data());
+        for (PcfTable<uint32_t>::InsertResult result : inserted) {
+            out.push_back(static_cast<char>(result == PcfTable<uint32_t>::INSERTED    ? FrameHeader::ADDED
+                                            : result == PcfTable<uint32_t>::DUPLICATE ? FrameHeader::DUPLICATE
+                                                                                      : FrameHeader::ADD_FAILED));
+        }
+        return true;
+    }
+
+    bool remove(uint32_t count, string_view body, string& out) {
+        if (!read_keys(count, body)) return false;
+        removed.reset(new bool[count]);
+        manager.remove_batch(keys.data(), count, removed.get());
+        for (uint32_t i = 0; i < count; i++) {
+            out.push_back(static_cast<char>(removed[i] ? FrameHeader::REMOVED : FrameHeader::NOT_FOUND));
+        }
+        return true;
+    }
+
+    bool stats(string& out) {
+        ostringstream json;
+        stats_snapshot().write_json(json);
+        out += json.str();
+        return true;
+    }
+
+    UTXOManager<>& manager;
+    StatsExporter& exporter;
+    LatencyHistogram latency;
+    vector<OutPoint> keys; // request scratch, kept across requests
+    vector<string_view> found;
+    vector<PcfTable<uint32_t>::InsertResult> inserted;
+    unique_ptr<bool[]> removed;
+};
+
+atomic<bool> stop_requested(false);
+
+// Serves until SIGINT or SIGTERM
+void run_server(UTXOManager<>& manager, StatsExporter& exporter, const string& address, uint16_t port) {
+    UtxoServer<UtxoService> server;
+    string error;
+    if (!server.listen(address, port, error)) {
+        cerr << "Cannot listen on " << error << "\n";
+        return;
     }
+    struct sigaction action {};
+    action.sa_handler = [](int) { stop_requested = true; };
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    UtxoService service(manager, exporter);
+    cout << "Serving " << manager.count() << " UTXOs on " << address << ":" << server.port() << " (Ctrl-C stops)\n";
+    server.run(service, stop_requested);
+    exporter.write(service.stats_snapshot());
+    UtxoStatsSnapshot snapshot = service.stats_snapshot();
+    cout << "\nServed " << snapshot.requests << " requests | p50 " << snapshot.request_p50_ns << " ns | p99 "
+         << snapshot.request_p99_ns << " ns | p999 " << snapshot.request_p999_ns << " ns\n";
+    manager.poll_compaction(true);
 }
 
-int main() {
-    UTXOManager manager;
+// Pipelined GET load against a server: `depth` requests of `batch` keys
+// in flight, keys from the dump in random order. Reports lookups per
+// second and round-trip latency, then the server's own percentiles.
+int run_client(const string& filename, const string& host, uint16_t port, size_t batch, size_t depth, size_t requests) {
+    vector<OutPoint> keys;
+    UtxoCsvReader reader;
+    if (!reader.open(filename)) {
+        cerr << "Error: Cannot open file " << filename << endl;
+        return 1;
+    }
+    CsvRow row;
+    UtxoRecord record;
+    OutPoint key;
+    while (reader.next(row)) {
+        if (parse_utxo_row(row, record) && parse_outpoint(record.key, key)) keys.push_back(key);
+    }
+    if (keys.empty()) {
+        cerr << "No keys in " << filename << "\n";
+        return 1;
+    }
+    mt19937_64 rng(7);
+    shuffle(keys.begin(), keys.end(), rng);
+    batch = min(batch, keys.size());
+
+    UtxoClient client;
+    string error;
+    if (!client.connect(host, port, error)) {
+        cerr << "Cannot connect to " << error << "\n";
+        return 1;
+    }
+    vector<chrono::steady_clock::time_point> sent_at(depth);
+    vector<double> round_trips;
+    round_trips.reserve(requests);
+    string frames;
+    size_t next_key = 0, sent = 0, hits = 0, lookups = 0;
+    auto queue_request = [&](uint32_t id) {
+        if (next_key + batch > keys.size()) next_key = 0;
+        append_get_request(frames, id, keys.data() + next_key, batch);
+        next_key += batch;
+        sent_at[id % depth] = chrono::steady_clock::now();
+        sent++;
+    };
+
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < depth && sent < requests; i++) queue_request(static_cast<uint32_t>(sent));
+    for (size_t received = 0; received < requests; received++) {
+        if (!frames.empty()) {
+            if (!client.send(frames)) {
+                cerr << "Connection lost\n";
+                return 1;
+            }
+            frames.clear();
+        }
+        FrameHeader response;
+        string_view body;
+        if (!client.receive(response, body)) {
+            cerr << "Connection lost\n";
+            return 1;
+        }
+        if (response.status != FrameHeader::OK) {
+            cerr << (response.status == FrameHeader::TOO_LARGE ? "Response too large, use a smaller --batch\n"
+                                                               : "Request rejected\n");
+            return 1;
+        }
+        round_trips.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - sent_at[response.request_id % depth]).count());
+        BodyReader values(body);
+        for (uint32_t i = 0; i < response.count; i++) {
+            uint32_t length;
+            string_view value;
+            if (!values.read(length) || !values.read_bytes(length, value)) break;
+            hits += length > 0;
+        }
+        lookups += response.count;
+        if (sent < requests) queue_request(static_cast<uint32_t>(sent));
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << fixed << setprecision(0) << requests << " GET requests of " << batch << " keys, " << depth << " in flight: "
+         << lookups / seconds << " lookups/s, " << hits << " of " << lookups << " found\n";
+    if (!round_trips.empty()) {
+        sort(round_trips.begin(), round_trips.end());
+        auto rank = [&](double q) { return round_trips[static_cast<size_t>(q * (round_trips.size() - 1))]; };
+        cout << "Round trip per request: p50 " << rank(0.50) / 1000 << " us | p99 " << rank(0.99) / 1000
+             << " us | p999 " << rank(0.999) / 1000 << " us\n";
+    }
+
+    append_stats_request(frames, 0);
+    FrameHeader response;
+    string_view body;
+    if (client.send(frames) && client.receive(response, body)) cout << "Server stats: " << body << "\n";
+    return 0;
+}
+
+// Perfect_Cuckoo_Filter                      interactive menu
+// Perfect_Cuckoo_Filter serve [--bind ADDR] [--port N]
+// Perfect_Cuckoo_Filter client [--host HOST] [--port N] [--batch N] [--depth N] [--requests N]
+int main(int argc, char** argv) {
+    string mode = argc > 1 ? argv[1] : "";
+    string address = "127.0.0.1", host = "127.0.0.1";
+    uint16_t port = 8533;
+    size_t batch = 64, depth = 16, requests = 100000;
+    bool bad_arg = mode != "" && mode != "serve" && mode != "client";
+    for (int i = 2; i < argc && !bad_arg; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--bind" && has_value && mode == "serve") {
+            address = argv[++i];
+        } else if (arg == "--host" && has_value && mode == "client") {
+            host = argv[++i];
+        } else if (arg == "--port" && has_value) {
+            port = static_cast<uint16_t>(stoul(argv[++i]));
+        } else if (arg == "--batch" && has_value && mode == "client") {
+            batch = min<size_t>(max<size_t>(1, stoull(argv[++i])), FrameHeader::MAX_BODY_BYTES / sizeof(OutPoint));
+        } else if (arg == "--depth" && has_value && mode == "client") {
+            depth = max<size_t>(1, stoull(argv[++i]));
+        } else if (arg == "--requests" && has_value && mode == "client") {
+            requests = stoull(argv[++i]);
+        } else {
+            bad_arg = true;
+        }
+    }
+    if (bad_arg) {
+        cerr << "Usage: " << argv[0] << " [serve [--bind ADDR] [--port N]]\n"
+             << "       " << argv[0] << " client [--host HOST] [--port N] [--batch N] [--depth N] [--requests N]\n";
+        return 1;
+    }
+
+    UTXOManager<> manager;
+    manager.enable_growth();
     const string filename = "combined_utxos.csv";
+    if (mode == "client") return run_client(filename, host, port, batch, depth, requests);
+    const string snapshot = "combined_utxos.pcf";
+    const string log = "combined_utxos.wal";
+    const string stats_csv = "combined_utxos.stats.csv";
+    const string stats_json = "combined_utxos.stats.json";
+
+    // A snapshot at least as new as the dump replaces the CSV load
+    struct stat csv_stat, snapshot_stat;
+    bool have_csv = stat(filename.c_str(), &csv_stat) == 0;
+    bool fresh_snapshot = stat(snapshot.c_str(), &snapshot_stat) == 0 &&
+                          (!have_csv || snapshot_stat.st_mtime >= csv_stat.st_mtime);
+    uint64_t best_height = 0;
+    auto start = chrono::steady_clock::now();
+    if (fresh_snapshot && manager.load_snapshot(snapshot, best_height)) {
+        cout << "Mapped snapshot " << snapshot << " (best height " << best_height << ") in "
+             << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms\n";
+    } else {
+        cout << "Loading UTXO dataset from " << filename << "...\n";
+        best_height = load_utxo_dataset(manager, filename);
+        if (manager.count() > 0 && manager.save_snapshot(snapshot, best_height)) {
+            cout << "Snapshot written to " << snapshot << "\n";
+        }
+        // The log held changes to the previous snapshot
+        remove(log.c_str());
+        remove(WriteAheadLog::old_path(log).c_str());
+    }
 
-    cout << "Loading UTXO dataset from " << filename << "...\n";
-    load_utxo_dataset(manager, filename);
+    // Changes made after the snapshot are replayed from the log, and the
+    // log is folded into a new snapshot in the background
+    long replayed = manager.open_log(log);
+    if (replayed > 0) {
+        cout << "Replayed " << replayed << " logged changes from " << log << "\n";
+        manager.start_compaction();
+    }
 
     if (manager.count() == 0) {
         cout << "\nCRITICAL: No UTXOs loaded. Please verify:\n"
@@ -434,7 +979,15 @@ int main() {
              << "3. Check the raw lines and parsing output above\n"
              << "4. Try viewing the file with: cat -A " << filename << " | head -n 5\n";
     } else {
-        run_interactive(manager);
+        StatsExporter exporter;
+        if (!exporter.open(stats_csv, stats_json)) cerr << "Cannot open " << stats_csv << "\n";
+        exporter.write(manager.stats_snapshot());
+        if (mode == "serve") {
+            run_server(manager, exporter, address, port);
+        } else {
+            run_interactive(manager, exporter);
+            exporter.write(manager.stats_snapshot());
+        }
     }
 
     cout << "\nProgram exiting. Final UTXO count: " << manager.count() << endl;
@@ -0,0 +1,117 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+//-----------------------------------------------------------------------------
+// Measured heap usage, per thread, for the parameter sweeps.
+//
+// Replaces the global operator new / delete (every form: plain, array,
+// aligned, sized and nothrow) with malloc-backed versions that charge
+// malloc_usable_size() of every block to the calling thread's current
+// AllocationAccount, if any. A ChargeTo guard picks the account for its
+// scope:
+//
+//     AllocationAccount filter_bytes;
+//     { ChargeTo charge(filter_bytes); manager.add_utxo(key, value); }
+//
+// Frees are credited to the account current at the time, so an account
+// reads the live bytes of what was built under it as long as it is also
+// freed (or kept) under it. Memory mapped by a non-default MemoryPolicy
+// (src/memory_policy.h) bypasses operator new and shows in
+// PolicyMemory::counters() instead.
+//
+// Defines the replacement operators: include in one translation unit per
+// program.
+//-----------------------------------------------------------------------------
+
+class AllocationAccount {
+public:
+    int64_t bytes() const { return bytes_; }
+    double megabytes() const { return bytes_ / (1024.0 * 1024.0); }
+
+    static AllocationAccount*& current() {
+        thread_local AllocationAccount* account = nullptr;
+        return account;
+    }
+
+    static void charge(void* block) {
+        if (block && current()) current()->bytes_ += static_cast<int64_t>(malloc_usable_size(block));
+    }
+    static void credit(void* block) {
+        if (block && current()) current()->bytes_ -= static_cast<int64_t>(malloc_usable_size(block));
+    }
+
+private:
+    int64_t bytes_ = 0;
+};
+
+class ChargeTo {
+public:
+    explicit ChargeTo(AllocationAccount& account) : previous_(AllocationAccount::current()) {
+        AllocationAccount::current() = &account;
+    }
+    ~ChargeTo() { AllocationAccount::current() = previous_; }
+
+    ChargeTo(const ChargeTo&) = delete;
+    ChargeTo& operator=(const ChargeTo&) = delete;
+
+private:
+    AllocationAccount* previous_;
+};
+
+namespace alloc_counter_detail {
+
+inline void* allocate(size_t bytes, size_t alignment) {
+    void* block;
+    if (alignment <= alignof(std::max_align_t)) {
+        block = std::malloc(bytes ? bytes : 1);
+    } else {
+        size_t rounded = bytes ? (bytes + alignment - 1) / alignment * alignment : alignment;
+        block = std::aligned_alloc(alignment, rounded);
+    }
+    AllocationAccount::charge(block);
+    return block;
+}
+
+inline void* allocate_or_throw(size_t bytes, size_t alignment) {
+    void* block = allocate(bytes, alignment);
+    if (!block) throw std::bad_alloc();
+    return block;
+}
+
+inline void release(void* block) noexcept {
+    AllocationAccount::credit(block);
+    std::free(block);
+}
+
+} // namespace alloc_counter_detail
+
+void* operator new(size_t bytes) { return alloc_counter_detail::allocate_or_throw(bytes, 0); }
+void* operator new[](size_t bytes) { return alloc_counter_detail::allocate_or_throw(bytes, 0); }
+void* operator new(size_t bytes, std::align_val_t align) {
+    return alloc_counter_detail::allocate_or_throw(bytes, static_cast<size_t>(align));
+}
+void* operator new[](size_t bytes, std::align_val_t align) {
+    return alloc_counter_detail::allocate_or_throw(bytes, static_cast<size_t>(align));
+}
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept { return alloc_counter_detail::allocate(bytes, 0); }
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept { return alloc_counter_detail::allocate(bytes, 0); }
+
+void operator delete(void* block) noexcept { alloc_counter_detail::release(block); }
+void operator delete[](void* block) noexcept { alloc_counter_detail::release(block); }
+void operator delete(void* block, size_t) noexcept { alloc_counter_detail::release(block); }
+void operator delete[](void* block, size_t) noexcept { alloc_counter_detail::release(block); }
+void operator delete(void* block, std::align_val_t) noexcept { alloc_counter_detail::release(block); }
+void operator delete[](void* block, std::align_val_t) noexcept { alloc_counter_detail::release(block); }
+void operator delete(void* block, size_t, std::align_val_t) noexcept { alloc_counter_detail::release(block); }
+void operator delete[](void* block, size_t, std::align_val_t) noexcept { alloc_counter_detail::release(block); }
+void operator delete(void* block, const std::nothrow_t&) noexcept { alloc_counter_detail::release(block); }
+void operator delete[](void* block, const std::nothrow_t&) noexcept { alloc_counter_detail::release(block); }
+
+#endif
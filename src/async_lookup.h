@@ -0,0 +1,192 @@
+#ifndef ASYNC_LOOKUP_H
+#define ASYNC_LOOKUP_H
+
+//-----------------------------------------------------------------------------
+// Coroutine lookups interleaved for memory-level parallelism (C++20).
+//
+// Code that validates one input at a time is written as a LookupTask
+// coroutine that does `co_await manager.async_get(key)`. The awaiter runs a
+// lookup as stages: hashing and prefetching the candidate buckets on
+// suspension, then probing and prefetching the value, then decoding it on
+// resumption. Every stage ends with a memory request in flight, so the
+// lookup goes to the back of the LookupScheduler's queue and the stages of
+// up to `width` other lookups run while it lands, as multi_get() does with
+// an explicit ring of keys.
+//
+// LookupScheduler::run(n, make_task) starts make_task(i) for i in [0, n),
+// keeping at most `width` tasks in flight, and returns when all have
+// finished. Tasks are resumed only by run(), on its thread. A task may
+// await any number of lookups and may return early. Task frames come from
+// per-thread free lists, so starting a task does not hit the allocator
+// in steady state.
+//
+// Only built when the compiler supports coroutines (-std=c++20);
+// HAVE_ASYNC_LOOKUP is defined then.
+//-----------------------------------------------------------------------------
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define HAVE_ASYNC_LOOKUP 1
+
+#include <coroutine>
+#include <cstddef>
+#include <vector>
+#include <exception>
+#include <new>
+#include <utility>
+
+class LookupScheduler;
+
+// Per-thread free lists of coroutine frames by size, in 64-byte classes
+class FramePool {
+public:
+    static void* allocate(size_t bytes) {
+        size_t c = size_class(bytes);
+        if (c >= CLASSES) return ::operator new(bytes);
+        Free*& head = lists()[c];
+        if (!head) return ::operator new(c * GRANULE + GRANULE);
+        Free* frame = head;
+        head = frame->next;
+        return frame;
+    }
+
+    static void release(void* frame, size_t bytes) {
+        size_t c = size_class(bytes);
+        if (c >= CLASSES) return ::operator delete(frame);
+        Free*& head = lists()[c];
+        head = new (frame) Free{head};
+    }
+
+private:
+    static const size_t GRANULE = 64;
+    static const size_t CLASSES = 16;
+
+    struct Free {
+        Free* next;
+    };
+
+    static size_t size_class(size_t bytes) { return (bytes - 1) / GRANULE; }
+
+    // Frames still listed at thread exit are left to the OS
+    static Free** lists() {
+        thread_local Free* heads[CLASSES] = {};
+        return heads;
+    }
+};
+
+class LookupTask {
+public:
+    struct promise_type {
+        LookupScheduler* scheduler = nullptr;
+        std::exception_ptr error;
+
+        static void* operator new(size_t bytes) { return FramePool::allocate(bytes); }
+        static void operator delete(void* frame, size_t bytes) { FramePool::release(frame, bytes); }
+
+        LookupTask get_return_object() { return LookupTask(Handle::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; } // started by the scheduler
+        std::suspend_always final_suspend() noexcept { return {}; }  // destroyed by the scheduler
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+    using Handle = std::coroutine_handle<promise_type>;
+
+    LookupTask(LookupTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    LookupTask(const LookupTask&) = delete;
+    LookupTask& operator=(const LookupTask&) = delete;
+    ~LookupTask() {
+        if (handle_) handle_.destroy();
+    }
+
+    Handle release() { return std::exchange(handle_, nullptr); }
+
+private:
+    explicit LookupTask(Handle handle) : handle_(handle) {}
+
+    Handle handle_;
+};
+
+// A suspended lookup: advance() runs its next stage and returns true once
+// the result is ready for the waiting task
+struct AsyncStep {
+    LookupTask::Handle waiter;
+    bool (*advance)(AsyncStep&) = nullptr;
+};
+
+class LookupScheduler {
+public:
+    static const size_t DEFAULT_WIDTH = 16; // lookups in flight
+
+    explicit LookupScheduler(size_t width = DEFAULT_WIDTH) : width_(width ? width : 1), ready_(width_) {}
+
+    template <typename MakeTask>
+    void run(size_t n, MakeTask make_task) {
+        size_t next = 0, active = 0;
+        while (next < n || active > 0) {
+            while (active < width_ && next < n) {
+                LookupTask::Handle handle = make_task(next++).release();
+                handle.promise().scheduler = this;
+                active++;
+                resume(handle, active);
+            }
+            if (queued_ == 0) continue;
+            AsyncStep* step = ready_[head_];
+            head_ = head_ + 1 == width_ ? 0 : head_ + 1;
+            queued_--;
+            if (step->advance(*step)) {
+                resume(step->waiter, active);
+            } else {
+                enqueue(step);
+            }
+        }
+    }
+
+    // Called by awaiters after issuing a step's prefetches; every task in
+    // flight has at most one step queued
+    void enqueue(AsyncStep* step) {
+        size_t tail = head_ + queued_;
+        ready_[tail < width_ ? tail : tail - width_] = step;
+        queued_++;
+    }
+
+private:
+    // Runs a task to its next co_await (which enqueues a step) or its end
+    void resume(LookupTask::Handle handle, size_t& active) {
+        handle.resume();
+        if (!handle.done()) return;
+        std::exception_ptr error = handle.promise().error;
+        handle.destroy();
+        active--;
+        if (error) std::rethrow_exception(error);
+    }
+
+    size_t width_;
+    std::vector<AsyncStep*> ready_; // ring of queued steps, oldest at head_
+    size_t head_ = 0;
+    size_t queued_ = 0;
+};
+
+// Awaiter over a Probe with prefetch() (the first stage, on suspension),
+// bool step() (a later stage; true when done) and result() (on resumption)
+template <typename Probe>
+class AsyncLookup : private AsyncStep {
+public:
+    explicit AsyncLookup(Probe probe) : probe_(std::move(probe)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(LookupTask::Handle handle) {
+        waiter = handle;
+        advance = [](AsyncStep& step) { return static_cast<AsyncLookup&>(step).probe_.step(); };
+        probe_.prefetch();
+        handle.promise().scheduler->enqueue(this);
+    }
+
+    auto await_resume() { return probe_.result(); }
+
+private:
+    Probe probe_;
+};
+
+#endif
+
+#endif
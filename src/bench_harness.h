@@ -0,0 +1,387 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "outpoint.h"
+
+//-----------------------------------------------------------------------------
+// Shared benchmark workloads and batch timing.
+//
+// BatchTimer reads the clock once per batch of operations and records the
+// batch's average per operation, so a 20 ns lookup is not swamped by the
+// cost of the clock read itself. Percentiles are over those batch
+// averages (nearest rank); p999 needs at least 1000 batches to mean
+// anything.
+//
+// The workloads drive any target with
+//
+//   bool add(const OutPoint& key, uint64_t seq)   seq varies the value
+//   bool get(const OutPoint& key)                 looks up and reads the value
+//   bool remove(const OutPoint& key)
+//
+// (computational_Time_CuckooUTXO.cpp wraps each manager in BenchTarget).
+// Every workload starts from a fresh target made by the caller's factory;
+// the keys a query or delete workload needs are added untimed first.
+//-----------------------------------------------------------------------------
+
+struct LatencySummary {
+    size_t ops = 0;
+    double seconds = 0;
+    double p50_ns = 0, p99_ns = 0, p999_ns = 0; // per op, over batch averages
+
+    double mean_ns() const { return ops ? seconds * 1e9 / ops : 0; }
+    double ops_per_second() const { return seconds > 0 ? ops / seconds : 0; }
+};
+
+class BatchTimer {
+public:
+    static constexpr size_t DEFAULT_BATCH_OPS = 256;
+
+    explicit BatchTimer(size_t batch_ops = DEFAULT_BATCH_OPS) : batch_ops_(batch_ops ? batch_ops : 1) {}
+
+    // Calls op(i) for every i in [0, n), timing batch_ops() calls at a time
+    template <typename Op>
+    void run(size_t n, Op&& op) {
+        for (size_t first = 0; first < n; first += batch_ops_) {
+            size_t end = std::min(n, first + batch_ops_);
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = first; i < end; i++) op(i);
+            record(end - first, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+
+    // A span the caller timed itself, e.g. one whole block of `ops` operations
+    void record(size_t ops, double ns) {
+        if (ops == 0) return;
+        per_op_ns_.push_back(ns / ops);
+        ops_ += ops;
+        total_ns_ += ns;
+    }
+
+    LatencySummary summary() const {
+        LatencySummary s;
+        s.ops = ops_;
+        s.seconds = total_ns_ / 1e9;
+        if (per_op_ns_.empty()) return s;
+        std::vector<double> sorted(per_op_ns_);
+        std::sort(sorted.begin(), sorted.end());
+        auto rank = [&](double q) { return sorted[std::min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()))]; };
+        s.p50_ns = rank(0.50);
+        s.p99_ns = rank(0.99);
+        s.p999_ns = rank(0.999);
+        return s;
+    }
+
+    void clear() {
+        per_op_ns_.clear();
+        ops_ = 0;
+        total_ns_ = 0;
+    }
+
+    size_t batch_ops() const { return batch_ops_; }
+
+private:
+    size_t batch_ops_;
+    std::vector<double> per_op_ns_; // one entry per batch
+    size_t ops_ = 0;
+    double total_ns_ = 0;
+};
+
+// Uniformly random key: the whole txid and a vout below 1000
+template <typename Rng>
+OutPoint random_outpoint(Rng& rng) {
+    OutPoint key;
+    for (size_t i = 0; i < sizeof(key.txid); i += sizeof(uint64_t)) {
+        uint64_t word = (static_cast<uint64_t>(rng()) << 32) ^ rng();
+        std::memcpy(key.txid + i, &word, sizeof(word));
+    }
+    key.vout = static_cast<uint32_t>(rng() % 1000);
+    return key;
+}
+
+// `count` distinct keys to insert and `count` more that are none of them
+struct BenchKeys {
+    std::vector<OutPoint> present;
+    std::vector<OutPoint> absent;
+
+    template <typename Rng>
+    static BenchKeys random(size_t count, Rng& rng) {
+        return random(count, count, rng);
+    }
+
+    // `present` distinct keys and `absent` others
+    template <typename Rng>
+    static BenchKeys random(size_t present, size_t absent, Rng& rng) {
+        BenchKeys keys;
+        keys.present.reserve(present);
+        keys.absent.reserve(absent);
+        std::unordered_set<OutPoint, OutPointHasher> seen;
+        seen.reserve(present + absent);
+        while (keys.present.size() < present) {
+            OutPoint key = random_outpoint(rng);
+            if (seen.insert(key).second) keys.present.push_back(key);
+        }
+        while (keys.absent.size() < absent) {
+            OutPoint key = random_outpoint(rng);
+            if (seen.insert(key).second) keys.absent.push_back(key);
+        }
+        return keys;
+    }
+};
+
+enum class BenchWorkload { INSERT_FILL, QUERY_POSITIVE, QUERY_NEGATIVE, DELETE, BLOCK_REPLAY };
+
+static const BenchWorkload ALL_BENCH_WORKLOADS[] = {BenchWorkload::INSERT_FILL, BenchWorkload::QUERY_POSITIVE,
+                                                    BenchWorkload::QUERY_NEGATIVE, BenchWorkload::DELETE,
+                                                    BenchWorkload::BLOCK_REPLAY};
+
+inline const char* bench_workload_name(BenchWorkload workload) {
+    switch (workload) {
+        case BenchWorkload::INSERT_FILL: return "insert-fill";
+        case BenchWorkload::QUERY_POSITIVE: return "query-positive";
+        case BenchWorkload::QUERY_NEGATIVE: return "query-negative";
+        case BenchWorkload::DELETE: return "delete";
+        case BenchWorkload::BLOCK_REPLAY: return "block-replay";
+    }
+    return "?";
+}
+
+inline bool parse_bench_workload(const std::string& name, BenchWorkload& workload) {
+    for (BenchWorkload w : ALL_BENCH_WORKLOADS) {
+        if (name == bench_workload_name(w)) {
+            workload = w;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Block replay: each block creates `creates` outputs, spends `spends` live
+// ones and looks up `queries` keys, half of them live. One create and one
+// spend in every 100 deliberately re-create a live key or spend an absent
+// one, to count false accepts. Hours of `blocks_per_hour` blocks are the
+// rows of the replay CSV.
+struct ReplayConfig {
+    size_t creates = 2000;
+    size_t spends = 1000;
+    size_t queries = 1000;
+    size_t blocks_per_hour = 6;
+};
+
+// One replay hour, the row schema of debug/Results.csv. A false positive
+// is an operation that succeeded but should not have (a duplicate create
+// accepted, an absent key found or spent); a false negative one that
+// failed but should not have. Rates are million operations per second.
+struct ReplayHour {
+    size_t hour = 0;
+    size_t inserts = 0, deletes = 0, queries = 0;
+    size_t insert_fp = 0, insert_fn = 0, insert_negatives = 0; // negatives: duplicate creates tried
+    size_t delete_fp = 0, delete_fn = 0, delete_negatives = 0; // negatives: absent spends tried
+    size_t query_fp = 0, query_fn = 0, query_negatives = 0;    // negatives: absent lookups
+    double insert_ns = 0, delete_ns = 0, query_ns = 0;
+
+    static void write_header(std::ostream& out) {
+        out << "Hour,FPR_Query,FNR_Query,FPR_Insert,FNR_Insert,FPR_Delete,FNR_Delete,Inserts,Deletes,Queries,"
+               "Insert_Rate,Delete_Rate,Query_Rate\n";
+    }
+
+    void write_row(std::ostream& out) const {
+        auto rate = [](size_t num, size_t den) { return den ? static_cast<double>(num) / den : 0.0; };
+        auto mops = [](size_t ops, double ns) { return ns > 0 ? ops * 1e3 / ns : 0.0; };
+        out << hour << "," << rate(query_fp, query_negatives) << "," << rate(query_fn, queries - query_negatives) << ","
+            << rate(insert_fp, insert_negatives) << "," << rate(insert_fn, inserts - insert_negatives) << ","
+            << rate(delete_fp, delete_negatives) << "," << rate(delete_fn, deletes - delete_negatives) << ","
+            << inserts << "," << deletes << "," << queries << "," << mops(inserts, insert_ns) << ","
+            << mops(deletes, delete_ns) << "," << mops(queries, query_ns) << "\n";
+    }
+
+    size_t errors() const { return insert_fp + insert_fn + delete_fp + delete_fn + query_fp + query_fn; }
+};
+
+struct BenchResult {
+    std::string impl;
+    BenchWorkload workload = BenchWorkload::INSERT_FILL;
+    LatencySummary latency;
+    size_t failed = 0; // operations with the wrong outcome (for insert-fill: rejected adds)
+
+    static void write_header(std::ostream& out) {
+        out << "Impl,Workload,Ops,Failed,Seconds,Mops,Mean_ns,P50_ns,P99_ns,P999_ns\n";
+    }
+
+    void write_row(std::ostream& out) const {
+        out << impl << "," << bench_workload_name(workload) << "," << latency.ops << "," << failed << ","
+            << latency.seconds << "," << latency.ops_per_second() / 1e6 << "," << latency.mean_ns() << ","
+            << latency.p50_ns << "," << latency.p99_ns << "," << latency.p999_ns << "\n";
+    }
+};
+
+// Replays keys.present as blocks (see ReplayConfig) against `target`;
+// every block is one timed span of all its operations. Appends one
+// ReplayHour per hour to `hours` if given.
+template <typename Target>
+BenchResult run_block_replay(Target& target, const BenchKeys& keys, const ReplayConfig& config,
+                             std::vector<ReplayHour>* hours) {
+    BenchResult result;
+    result.workload = BenchWorkload::BLOCK_REPLAY;
+    BatchTimer timer;
+    std::mt19937_64 rng(23);
+    std::vector<OutPoint> live;
+    size_t next_create = 0, next_absent = 0, block = 0;
+    ReplayHour hour;
+
+    auto absent_key = [&]() { return keys.absent[next_absent++ % keys.absent.size()]; };
+    auto elapsed_ns = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    while (next_create < keys.present.size()) {
+        double block_ns = 0;
+        size_t block_ops = 0;
+
+        size_t creates = std::min(config.creates, keys.present.size() - next_create);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < creates; i++) {
+            bool duplicate = i % 100 == 99 && !live.empty();
+            const OutPoint& key = duplicate ? live[rng() % live.size()] : keys.present[next_create + i];
+            bool added = target.add(key, next_create + i);
+            if (duplicate) {
+                hour.insert_negatives++;
+                hour.insert_fp += added;
+            } else {
+                hour.insert_fn += !added;
+            }
+        }
+        double ns = elapsed_ns(start);
+        for (size_t i = 0; i < creates; i++) {
+            if (i % 100 != 99 || live.empty()) live.push_back(keys.present[next_create + i]);
+        }
+        next_create += creates;
+        hour.inserts += creates;
+        hour.insert_ns += ns;
+        block_ns += ns;
+        block_ops += creates;
+
+        // Picked before the clock starts; absent spends are interleaved
+        std::vector<OutPoint> spends;
+        std::vector<bool> spend_live;
+        for (size_t i = 0; i < config.spends && !live.empty(); i++) {
+            bool absent = i % 100 == 99;
+            if (absent) {
+                spends.push_back(absent_key());
+            } else {
+                size_t pick = rng() % live.size();
+                spends.push_back(live[pick]);
+                live[pick] = live.back();
+                live.pop_back();
+            }
+            spend_live.push_back(!absent);
+        }
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < spends.size(); i++) {
+            bool removed = target.remove(spends[i]);
+            if (spend_live[i]) {
+                hour.delete_fn += !removed;
+            } else {
+                hour.delete_negatives++;
+                hour.delete_fp += removed;
+            }
+        }
+        ns = elapsed_ns(start);
+        hour.deletes += spends.size();
+        hour.delete_ns += ns;
+        block_ns += ns;
+        block_ops += spends.size();
+
+        std::vector<OutPoint> lookups;
+        for (size_t i = 0; i < config.queries && !live.empty(); i++) {
+            lookups.push_back(i % 2 ? absent_key() : live[rng() % live.size()]);
+        }
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < lookups.size(); i++) {
+            bool found = target.get(lookups[i]);
+            if (i % 2) {
+                hour.query_negatives++;
+                hour.query_fp += found;
+            } else {
+                hour.query_fn += !found;
+            }
+        }
+        ns = elapsed_ns(start);
+        hour.queries += lookups.size();
+        hour.query_ns += ns;
+        block_ns += ns;
+        block_ops += lookups.size();
+
+        timer.record(block_ops, block_ns);
+        if (++block % config.blocks_per_hour == 0 || next_create == keys.present.size()) {
+            hour.hour = (block + config.blocks_per_hour - 1) / config.blocks_per_hour;
+            result.failed += hour.errors();
+            if (hours) hours->push_back(hour);
+            hour = ReplayHour();
+        }
+    }
+    result.latency = timer.summary();
+    return result;
+}
+
+// Runs one workload on a fresh target from make() (which returns a
+// pointer-like owner, e.g. std::unique_ptr)
+template <typename Make>
+BenchResult run_bench_workload(BenchWorkload workload, const std::string& impl, Make&& make, const BenchKeys& keys,
+                               size_t batch_ops, const ReplayConfig& replay, std::vector<ReplayHour>* hours) {
+    auto target = make();
+    BenchResult result;
+    if (workload == BenchWorkload::BLOCK_REPLAY) {
+        result = run_block_replay(*target, keys, replay, hours);
+        result.impl = impl;
+        return result;
+    }
+    result.impl = impl;
+    result.workload = workload;
+    const std::vector<OutPoint>& present = keys.present;
+    size_t failed = 0;
+    BatchTimer timer(batch_ops);
+    if (workload == BenchWorkload::INSERT_FILL) {
+        timer.run(present.size(), [&](size_t i) { failed += !target->add(present[i], i); });
+        result.latency = timer.summary();
+        result.failed = failed;
+        return result;
+    }
+
+    std::vector<bool> stored(present.size());
+    for (size_t i = 0; i < present.size(); i++) stored[i] = target->add(present[i], i);
+    // Shuffled, so the probes do not follow insertion order through memory
+    std::vector<size_t> order(present.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::mt19937_64 rng(29);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    switch (workload) {
+        case BenchWorkload::QUERY_POSITIVE:
+            timer.run(order.size(), [&](size_t i) { failed += stored[order[i]] && !target->get(present[order[i]]); });
+            break;
+        case BenchWorkload::QUERY_NEGATIVE:
+            timer.run(keys.absent.size(), [&](size_t i) { failed += target->get(keys.absent[i]); });
+            break;
+        case BenchWorkload::DELETE:
+            timer.run(order.size(), [&](size_t i) { failed += stored[order[i]] && !target->remove(present[order[i]]); });
+            break;
+        default:
+            break;
+    }
+    result.latency = timer.summary();
+    result.failed = failed;
+    return result;
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef BLOCKED_BLOOM_H
+#define BLOCKED_BLOOM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "bucket_table.h"
+
+//-----------------------------------------------------------------------------
+// Cache-line blocked Bloom filter over 32-bit key hashes, used as a
+// negative-lookup pre-filter in front of a cuckoo table.
+//
+// A hash picks one 64-byte block and sets one bit in each of its eight
+// 64-bit lanes, the bit positions taken from the hash times eight odd
+// salts (as in split block Bloom filters). A query therefore costs a
+// single memory access, and with AVX2 a set-and-test of the whole line in
+// two 256-bit registers; without it, a loop over the lanes.
+//
+// Bits are never cleared: an erased key leaves stale bits that only let
+// more absent keys through to the table, never hide a present one. The
+// owner rebuilds the filter from its entries once enough have gone (see
+// PcfTable::enable_prefilter()).
+//-----------------------------------------------------------------------------
+
+class BlockedBloomFilter {
+public:
+    static const size_t LANES = BucketTable::WORDS_PER_LINE;
+    static const size_t BLOCK_BITS = LANES * 64;
+    static constexpr double DEFAULT_BITS_PER_KEY = 12;
+
+    // Sized for `keys` entries at bits_per_key
+    BlockedBloomFilter(size_t keys, double bits_per_key = DEFAULT_BITS_PER_KEY) {
+        num_blocks_ = static_cast<size_t>(keys * bits_per_key / BLOCK_BITS) + 1;
+        data_ = static_cast<uint64_t*>(::operator new(memory_bytes(), std::align_val_t(BucketTable::CACHE_LINE)));
+        clear();
+    }
+
+    BlockedBloomFilter(const BlockedBloomFilter&) = delete;
+    BlockedBloomFilter& operator=(const BlockedBloomFilter&) = delete;
+    ~BlockedBloomFilter() { ::operator delete(data_, std::align_val_t(BucketTable::CACHE_LINE)); }
+
+    void add(uint32_t h) {
+        uint64_t* block = block_of(h);
+#ifdef __AVX2__
+        __m256i lo, hi;
+        lane_masks(h, lo, hi);
+        __m256i* lines = reinterpret_cast<__m256i*>(block);
+        _mm256_store_si256(lines, _mm256_or_si256(_mm256_load_si256(lines), lo));
+        _mm256_store_si256(lines + 1, _mm256_or_si256(_mm256_load_si256(lines + 1), hi));
+#else
+        uint32_t h2 = lane_hash(h);
+        for (size_t i = 0; i < LANES; i++) block[i] |= uint64_t(1) << lane_bit(h2, i);
+#endif
+    }
+
+    // False only if h was never added
+    bool may_contain(uint32_t h) const {
+        const uint64_t* block = block_of(h);
+#ifdef __AVX2__
+        __m256i lo, hi;
+        lane_masks(h, lo, hi);
+        const __m256i* lines = reinterpret_cast<const __m256i*>(block);
+        return _mm256_testc_si256(_mm256_load_si256(lines), lo) && _mm256_testc_si256(_mm256_load_si256(lines + 1), hi);
+#else
+        uint32_t h2 = lane_hash(h);
+        for (size_t i = 0; i < LANES; i++) {
+            if (!((block[i] >> lane_bit(h2, i)) & 1)) return false;
+        }
+        return true;
+#endif
+    }
+
+    void prefetch(uint32_t h) const { __builtin_prefetch(block_of(h)); }
+
+    void clear() { std::memset(data_, 0, memory_bytes()); }
+
+    size_t block_count() const { return num_blocks_; }
+    size_t memory_bytes() const { return num_blocks_ * BucketTable::CACHE_LINE; }
+
+private:
+    // Low half of the mixed hash picks the lane bits, high half the block
+    static uint64_t mix(uint32_t h) { return h * 0x9E3779B97F4A7C15ull; }
+    static uint32_t lane_hash(uint32_t h) { return static_cast<uint32_t>(mix(h)); }
+    static uint32_t lane_bit(uint32_t h2, size_t lane) { return (h2 * SALTS[lane]) >> 26; }
+
+    const uint64_t* block_of(uint32_t h) const { return data_ + LANES * ((mix(h) >> 32) * num_blocks_ >> 32); }
+    uint64_t* block_of(uint32_t h) { return data_ + LANES * ((mix(h) >> 32) * num_blocks_ >> 32); }
+
+#ifdef __AVX2__
+    // The bit of every lane, lanes 0-3 in lo and 4-7 in hi
+    static void lane_masks(uint32_t h, __m256i& lo, __m256i& hi) {
+        __m256i salts = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(SALTS));
+        __m256i bits = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(lane_hash(h)), salts), 26);
+        __m256i one = _mm256_set1_epi64x(1);
+        lo = _mm256_sllv_epi64(one, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(bits)));
+        hi = _mm256_sllv_epi64(one, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(bits, 1)));
+    }
+#endif
+
+    static constexpr uint32_t SALTS[LANES] = {0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+                                              0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u};
+
+    size_t num_blocks_;
+    uint64_t* data_;
+};
+
+#endif
@@ -0,0 +1,306 @@
+#ifndef BUCKET_TABLE_H
+#define BUCKET_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+
+#include "memory_policy.h"
+
+//-----------------------------------------------------------------------------
+// Flat, bit-packed cuckoo bucket storage.
+//
+// Every slot holds one tag of exactly `tag_bits` bits: the fingerprint
+// shifted left by one with the selector bit (0 = primary, 1 = alternate
+// bucket) in bit 0, so a filter with FINGERPRINT_BITS uses
+// FINGERPRINT_BITS + 1 bits per slot. Slots are laid out back to back
+// from bit 0 of the bucket; the bucket's occupancy count sits in the top
+// bits of its last word. With the default 4 x 14-bit geometry a whole
+// bucket is a single 64-bit word.
+//
+// All buckets live in one 64-byte aligned allocation. The per-bucket word
+// count is rounded up to a power of two (at most one cache line), so no
+// bucket straddles two lines and a lookup costs at most two misses
+// (primary + alternate bucket). Occupied slots are kept packed at the
+// front of the bucket; erasing moves the last tag into the hole.
+//
+// Single-word buckets are probed with a SWAR compare of every slot at
+// once; find2() checks both candidate buckets in one SSE4.1 register when
+// the target supports it.
+//
+// The table stores tags only. Managers that keep a payload per slot index
+// it by slot_index(bucket, slot) and follow the moves reported by erase().
+// A table can also be laid over memory it does not own (a mapped
+// snapshot, see src/pcf_snapshot.h) in the same format as data(), or put
+// on huge pages or NUMA nodes by a MemoryPolicy.
+//-----------------------------------------------------------------------------
+
+class BucketTable {
+public:
+    static const size_t CACHE_LINE = 64;
+    static const size_t WORDS_PER_LINE = CACHE_LINE / sizeof(uint64_t);
+
+    static uint32_t make_tag(uint32_t fingerprint, bool selector_bit) {
+        return (fingerprint << 1) | (selector_bit ? 1u : 0u);
+    }
+    static uint32_t tag_fingerprint(uint32_t tag) { return tag >> 1; }
+    static bool tag_selector(uint32_t tag) { return tag & 1; }
+
+    // log2 of the buckets in an aligned pair of cache lines (at least 1):
+    // the block size of blocked layouts, whose candidate buckets share a
+    // line or sit in the adjacent one that the hardware fetches alongside
+    static constexpr uint32_t line_pair_block_bits(size_t words_per_bucket) {
+        uint32_t bits = 1;
+        while ((size_t(2) << bits) * words_per_bucket <= 2 * WORDS_PER_LINE) bits++;
+        return bits;
+    }
+
+    // Zeroed storage allocated under `memory` (see src/memory_policy.h)
+    BucketTable(size_t num_buckets, size_t slots_per_bucket, uint32_t tag_bits,
+                const MemoryPolicy& memory = MemoryPolicy())
+        : BucketTable(nullptr, num_buckets, slots_per_bucket, tag_bits) {
+        memory_ = memory;
+        data_ = static_cast<uint64_t*>(PolicyMemory::allocate_zeroed(memory_bytes(), memory_));
+        owned_ = true;
+    }
+
+    // Over memory_bytes() of caller-owned, 64-byte aligned words, which must
+    // outlive the table
+    BucketTable(uint64_t* words, size_t num_buckets, size_t slots_per_bucket, uint32_t tag_bits)
+        : num_buckets_(num_buckets), slots_per_bucket_(slots_per_bucket), tag_bits_(tag_bits),
+          tag_mask_(tag_bits >= 64 ? ~0ull : (1ull << tag_bits) - 1), count_bits_(bits_for(slots_per_bucket)),
+          words_per_bucket_(compute_words(slots_per_bucket, tag_bits)), lane_low_(0), lane_high_(0), data_(words) {
+        if (words_per_bucket_ == 1) {
+            for (size_t i = 0; i < slots_per_bucket_; i++) lane_low_ |= 1ull << (i * tag_bits_);
+            lane_high_ = lane_low_ << (tag_bits_ - 1);
+        }
+    }
+
+    BucketTable(BucketTable&& other) noexcept
+        : num_buckets_(0), slots_per_bucket_(0), tag_bits_(0), tag_mask_(0), count_bits_(0),
+          words_per_bucket_(0), lane_low_(0), lane_high_(0), data_(nullptr) {
+        swap(other);
+    }
+
+    BucketTable& operator=(BucketTable&& other) noexcept {
+        if (this != &other) {
+            release();
+            swap(other);
+        }
+        return *this;
+    }
+
+    void swap(BucketTable& other) noexcept {
+        std::swap(num_buckets_, other.num_buckets_);
+        std::swap(slots_per_bucket_, other.slots_per_bucket_);
+        std::swap(tag_bits_, other.tag_bits_);
+        std::swap(tag_mask_, other.tag_mask_);
+        std::swap(count_bits_, other.count_bits_);
+        std::swap(words_per_bucket_, other.words_per_bucket_);
+        std::swap(lane_low_, other.lane_low_);
+        std::swap(lane_high_, other.lane_high_);
+        std::swap(data_, other.data_);
+        std::swap(owned_, other.owned_);
+        std::swap(memory_, other.memory_);
+    }
+
+    BucketTable(const BucketTable&) = delete;
+    BucketTable& operator=(const BucketTable&) = delete;
+
+    ~BucketTable() { release(); }
+
+    size_t size() const { return num_buckets_; }
+    size_t slots_per_bucket() const { return slots_per_bucket_; }
+    uint32_t tag_bits() const { return tag_bits_; }
+    size_t words_per_bucket() const { return words_per_bucket_; }
+    size_t memory_bytes() const { return num_buckets_ * words_per_bucket_ * sizeof(uint64_t); }
+    size_t slot_index(size_t b, size_t slot) const { return b * slots_per_bucket_ + slot; }
+    const uint64_t* data() const { return data_; }
+
+    size_t count(size_t b) const {
+        return get_bits(bucket(b), count_offset(), count_bits_);
+    }
+    bool full(size_t b) const { return count(b) == slots_per_bucket_; }
+
+    // Starts loading bucket b's cache line ahead of a probe
+    void prefetch(size_t b) const { __builtin_prefetch(bucket(b)); }
+
+    uint32_t tag(size_t b, size_t slot) const {
+        return static_cast<uint32_t>(get_bits(bucket(b), slot * tag_bits_, tag_bits_));
+    }
+
+    void set_tag(size_t b, size_t slot, uint32_t tag) {
+        set_bits(bucket(b), slot * tag_bits_, tag_bits_, tag & tag_mask_);
+    }
+
+    // Bitmask of the occupied slots in bucket b that hold `tag`.
+    uint32_t match_mask(size_t b, uint32_t tag) const {
+        const uint64_t* w = bucket(b);
+        if (words_per_bucket_ == 1) return lanes_to_slots(swar_match(w[0], tag));
+        size_t n = get_bits(w, count_offset(), count_bits_);
+        uint32_t mask = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (get_bits(w, i * tag_bits_, tag_bits_) == tag) mask |= 1u << i;
+        }
+        return mask;
+    }
+
+    // Slot holding `tag` in bucket b, or -1.
+    int find(size_t b, uint32_t tag) const {
+        uint32_t mask = match_mask(b, tag);
+        return mask ? __builtin_ctz(mask) : -1;
+    }
+
+    // Probes tag1 in b1 and tag2 in b2 together. Returns the matching slot
+    // (b1 preferred) and sets `which` to the bucket it was found in, or -1.
+    // Single-word buckets are compared in one SSE register, both buckets
+    // and every slot at once; wider buckets fall back to the scalar scan.
+    int find2(size_t b1, uint32_t tag1, size_t b2, uint32_t tag2, size_t& which) const {
+        if (words_per_bucket_ == 1) {
+#ifdef __SSE4_1__
+            __m128i words = _mm_set_epi64x(bucket(b2)[0], bucket(b1)[0]);
+            __m128i query = _mm_set_epi64x(tag2 * lane_low_, tag1 * lane_low_);
+            __m128i lanes = _mm_set1_epi64x(lane_high_ - lane_low_);
+            __m128i x = _mm_xor_si128(words, query);
+            __m128i y = _mm_add_epi64(_mm_and_si128(x, lanes), lanes);
+            y = _mm_andnot_si128(_mm_or_si128(_mm_or_si128(y, x), lanes), _mm_set1_epi64x(lane_high_));
+            y = _mm_and_si128(y, _mm_set_epi64x(occupied_lanes(bucket(b2)[0]), occupied_lanes(bucket(b1)[0])));
+            if (_mm_testz_si128(y, y)) return -1;
+            uint64_t m1 = _mm_cvtsi128_si64(y);
+            uint64_t m = m1 ? m1 : static_cast<uint64_t>(_mm_extract_epi64(y, 1));
+            which = m1 ? b1 : b2;
+            return __builtin_ctzll(m) / tag_bits_;
+#else
+            uint64_t m = swar_match(bucket(b1)[0], tag1);
+            which = b1;
+            if (!m) {
+                m = swar_match(bucket(b2)[0], tag2);
+                which = b2;
+            }
+            return m ? static_cast<int>(__builtin_ctzll(m) / tag_bits_) : -1;
+#endif
+        }
+        int slot = find(b1, tag1);
+        which = b1;
+        if (slot < 0) {
+            slot = find(b2, tag2);
+            which = b2;
+        }
+        return slot;
+    }
+
+    // Appends `tag` to bucket b and returns its slot, or -1 if full.
+    int insert(size_t b, uint32_t tag) {
+        uint64_t* w = bucket(b);
+        size_t n = get_bits(w, count_offset(), count_bits_);
+        if (n == slots_per_bucket_) return -1;
+        set_bits(w, n * tag_bits_, tag_bits_, tag & tag_mask_);
+        set_bits(w, count_offset(), count_bits_, n + 1);
+        return static_cast<int>(n);
+    }
+
+    // Empties bucket b.
+    void clear(size_t b) {
+        std::memset(bucket(b), 0, words_per_bucket_ * sizeof(uint64_t));
+    }
+
+    // Removes the tag in `slot`, moving the bucket's last tag into its
+    // place. Returns the slot the moved tag came from (== slot if nothing
+    // moved) so callers can move the matching payload.
+    size_t erase(size_t b, size_t slot) {
+        uint64_t* w = bucket(b);
+        size_t last = get_bits(w, count_offset(), count_bits_) - 1;
+        if (slot != last) {
+            set_bits(w, slot * tag_bits_, tag_bits_, get_bits(w, last * tag_bits_, tag_bits_));
+        }
+        set_bits(w, last * tag_bits_, tag_bits_, 0);
+        set_bits(w, count_offset(), count_bits_, last);
+        return last;
+    }
+
+private:
+    static uint32_t bits_for(size_t value) {
+        uint32_t bits = 1;
+        while ((1ull << bits) <= value) bits++;
+        return bits;
+    }
+
+    static size_t compute_words(size_t slots, uint32_t tag_bits) {
+        size_t bits = slots * tag_bits + bits_for(slots);
+        size_t words = (bits + 63) / 64;
+        if (words > WORDS_PER_LINE) return words;
+        size_t rounded = 1;
+        while (rounded < words) rounded <<= 1;
+        return rounded;
+    }
+
+    static uint64_t get_bits(const uint64_t* w, size_t offset, uint32_t width) {
+        size_t word = offset >> 6, shift = offset & 63;
+        uint64_t value = w[word] >> shift;
+        if (shift + width > 64) value |= w[word + 1] << (64 - shift);
+        return width >= 64 ? value : value & ((1ull << width) - 1);
+    }
+
+    static void set_bits(uint64_t* w, size_t offset, uint32_t width, uint64_t value) {
+        size_t word = offset >> 6, shift = offset & 63;
+        uint64_t mask = width >= 64 ? ~0ull : (1ull << width) - 1;
+        w[word] = (w[word] & ~(mask << shift)) | (value << shift);
+        if (shift + width > 64) {
+            uint32_t spill = 64 - shift;
+            w[word + 1] = (w[word + 1] & ~(mask >> spill)) | (value >> spill);
+        }
+    }
+
+    // SWAR compare of a single-word bucket against `tag`: sets the top bit
+    // of every occupied lane equal to the tag. Exact (no carries between
+    // lanes), since the low tag_bits - 1 bits are summed separately.
+    uint64_t swar_match(uint64_t word, uint32_t tag) const {
+        uint64_t low_bits = lane_high_ - lane_low_;
+        uint64_t x = word ^ (tag * lane_low_);
+        uint64_t y = ((x & low_bits) + low_bits) | x | low_bits;
+        return ~y & lane_high_ & occupied_lanes(word);
+    }
+
+    uint64_t occupied_lanes(uint64_t word) const {
+        size_t n = word >> count_offset();
+        return n == slots_per_bucket_ ? ~0ull : (1ull << (n * tag_bits_)) - 1;
+    }
+
+    uint32_t lanes_to_slots(uint64_t lanes) const {
+        uint32_t mask = 0;
+        while (lanes) {
+            mask |= 1u << (__builtin_ctzll(lanes) / tag_bits_);
+            lanes &= lanes - 1;
+        }
+        return mask;
+    }
+
+    size_t count_offset() const { return words_per_bucket_ * 64 - count_bits_; }
+    const uint64_t* bucket(size_t b) const { return data_ + b * words_per_bucket_; }
+    uint64_t* bucket(size_t b) { return data_ + b * words_per_bucket_; }
+
+    void release() {
+        if (data_ && owned_) PolicyMemory::release(data_, memory_);
+        data_ = nullptr;
+        owned_ = false;
+    }
+
+    size_t num_buckets_;
+    size_t slots_per_bucket_;
+    uint32_t tag_bits_;
+    uint64_t tag_mask_;
+    uint32_t count_bits_;
+    size_t words_per_bucket_;
+    uint64_t lane_low_;  // lowest bit of every slot lane (single-word buckets)
+    uint64_t lane_high_; // highest bit of every slot lane
+    uint64_t* data_;
+    bool owned_ = false;
+    MemoryPolicy memory_;
+};
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef CHAIN_REPLAY_H
+#define CHAIN_REPLAY_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "outpoint.h"
+
+//-----------------------------------------------------------------------------
+// Block stream with Bitcoin-like spending locality, for replay benchmarks.
+//
+// Every block has a coinbase transaction and txs_per_block - 1 others, each
+// creating a number of outputs drawn from outputs_per_tx. The block then
+// spends about spends_per_output outputs per output it created. Spent
+// outputs are not uniform over the set: their age at spend (in blocks) is
+// 0 (created earlier in the same block) with probability
+// same_block_fraction, otherwise log-uniform over [1, max_age_blocks],
+// i.e. density proportional to 1/age. That puts half of the other spends
+// within about sqrt(max_age_blocks) blocks, as with real chains where most
+// outputs are spent young and a long tail lies dormant. Outputs older than
+// max_age_blocks are never spent. uniform_spends picks from the whole set
+// instead, the locality-free behavior of random-key benchmarks.
+//
+// The defaults follow the hourly mix of debug/Results.csv (about 2700
+// creates and 400 spends an hour, six blocks) at block scale. Keys are
+// random txids; use_outputs() takes the created outputs from a dump
+// instead, e.g. the dataset sorted by height, in the same block shape.
+//-----------------------------------------------------------------------------
+
+struct ChainReplayConfig {
+    size_t txs_per_block = 200;
+    std::vector<double> outputs_per_tx = {0.25, 0.60, 0.08, 0.04, 0.03}; // weights of 1, 2, 3, ... outputs
+    double spends_per_output = 0.15;
+    double same_block_fraction = 0.10;
+    size_t max_age_blocks = 52560; // about a year
+    bool uniform_spends = false;
+};
+
+struct ReplayOutput {
+    OutPoint key;
+    uint64_t amount = 0;
+    bool coinbase = false;
+};
+
+struct ReplayBlock {
+    uint64_t height = 0;
+    std::vector<ReplayOutput> creates;
+    std::vector<OutPoint> spends;  // spends[0, earlier_spends) are outputs of earlier blocks,
+    size_t earlier_spends = 0;     // the rest outputs of this block
+    uint64_t spend_age_sum = 0;    // in blocks, over all spends
+};
+
+class ChainReplay {
+public:
+    explicit ChainReplay(const ChainReplayConfig& config, uint64_t seed = 1, uint64_t start_height = 0)
+        : config_(config),
+          rng_(seed),
+          outputs_per_tx_(config.outputs_per_tx.begin(), config.outputs_per_tx.end()),
+          height_(start_height),
+          by_age_(config.max_age_blocks + 1) {}
+
+    // Creates these outputs, in order, instead of random ones; next()
+    // returns false once they are used up
+    void use_outputs(std::vector<ReplayOutput> outputs) {
+        dump_ = std::move(outputs);
+        next_dump_ = 0;
+        from_dump_ = true;
+    }
+
+    // The next block; false when the dump given to use_outputs() is exhausted
+    bool next(ReplayBlock& block) {
+        if (from_dump_ && next_dump_ >= dump_.size()) return false;
+        block.height = height_;
+        block.creates.clear();
+        block.spends.clear();
+        block.earlier_spends = 0;
+        block.spend_age_sum = 0;
+
+        for (size_t tx = 0; tx < config_.txs_per_block; tx++) {
+            size_t outputs = tx == 0 ? 1 + rng_() % 2 : 1 + outputs_per_tx_(rng_);
+            make_tx(outputs, tx == 0, block.creates);
+        }
+        if (block.creates.empty()) return false;
+
+        // Stochastic rounding keeps the long-run spend ratio exact
+        double expected = config_.spends_per_output * block.creates.size();
+        size_t spends = static_cast<size_t>(expected);
+        if (std::uniform_real_distribution<double>(0, 1)(rng_) < expected - spends) spends++;
+
+        std::vector<OutPoint>& current = config_.uniform_spends ? live_ : slot(height_);
+        if (!config_.uniform_spends) current.clear(); // outputs past max_age_blocks: never spent
+        std::vector<OutPoint> same_block;
+        for (size_t i = 0; i < block.creates.size(); i++) same_block.push_back(block.creates[i].key);
+
+        for (size_t i = 0; i < spends; i++) {
+            bool in_block = std::uniform_real_distribution<double>(0, 1)(rng_) < config_.same_block_fraction;
+            if (in_block && !same_block.empty()) {
+                size_t pick = rng_() % same_block.size();
+                pending_.push_back(same_block[pick]);
+                same_block[pick] = same_block.back();
+                same_block.pop_back();
+                continue;
+            }
+            OutPoint key;
+            uint64_t age;
+            if (take_earlier(key, age)) {
+                block.spends.push_back(key);
+                block.spend_age_sum += age;
+            }
+        }
+        block.earlier_spends = block.spends.size();
+        block.spends.insert(block.spends.end(), pending_.begin(), pending_.end());
+        pending_.clear();
+
+        // What this block did not spend itself joins the live set
+        for (const OutPoint& key : same_block) {
+            current.push_back(key);
+            if (config_.uniform_spends) created_at_.push_back(height_);
+        }
+        height_++;
+        return true;
+    }
+
+    uint64_t height() const { return height_; }
+
+private:
+    std::vector<OutPoint>& slot(uint64_t height) { return by_age_[height % by_age_.size()]; }
+
+    void make_tx(size_t outputs, bool coinbase, std::vector<ReplayOutput>& creates) {
+        OutPoint txid;
+        if (!from_dump_) {
+            for (size_t i = 0; i < sizeof(txid.txid); i += sizeof(uint64_t)) {
+                uint64_t word = rng_();
+                std::memcpy(txid.txid + i, &word, sizeof(word));
+            }
+        }
+        for (size_t vout = 0; vout < outputs; vout++) {
+            ReplayOutput output;
+            if (from_dump_) {
+                if (next_dump_ >= dump_.size()) return;
+                output = dump_[next_dump_++];
+            } else {
+                output.key = txid;
+                output.key.vout = static_cast<uint32_t>(vout);
+                output.amount = 1000 + rng_() % 100000000;
+                output.coinbase = coinbase;
+            }
+            creates.push_back(output);
+        }
+    }
+
+    // An output of an earlier block, by the age distribution; false if the
+    // ages tried all had nothing left
+    bool take_earlier(OutPoint& key, uint64_t& age) {
+        if (config_.uniform_spends) {
+            if (live_.empty()) return false;
+            size_t pick = rng_() % live_.size();
+            key = live_[pick];
+            age = height_ - created_at_[pick];
+            live_[pick] = live_.back();
+            live_.pop_back();
+            created_at_[pick] = created_at_.back();
+            created_at_.pop_back();
+            return true;
+        }
+        const double log_max = std::log(static_cast<double>(config_.max_age_blocks) + 1);
+        for (int attempt = 0; attempt < MAX_AGE_ATTEMPTS; attempt++) {
+            double u = std::uniform_real_distribution<double>(0, 1)(rng_);
+            age = static_cast<uint64_t>(std::exp(u * log_max));
+            if (age < 1) age = 1;
+            if (age > config_.max_age_blocks || age > height_) continue;
+            std::vector<OutPoint>& outputs = slot(height_ - age);
+            if (outputs.empty()) continue;
+            size_t pick = rng_() % outputs.size();
+            key = outputs[pick];
+            outputs[pick] = outputs.back();
+            outputs.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    static const int MAX_AGE_ATTEMPTS = 16;
+
+    ChainReplayConfig config_;
+    std::mt19937_64 rng_;
+    std::discrete_distribution<size_t> outputs_per_tx_;
+    uint64_t height_;
+    std::vector<std::vector<OutPoint>> by_age_; // live outputs by creation height % (max_age_blocks + 1)
+    std::vector<OutPoint> live_;                // uniform_spends: every live output
+    std::vector<uint64_t> created_at_;          //   and its creation height
+    std::vector<OutPoint> pending_;             // same-block spends of the block being built
+    std::vector<ReplayOutput> dump_;
+    size_t next_dump_ = 0;
+    bool from_dump_ = false;
+};
+
+#endif
@@ -0,0 +1,310 @@
+#ifndef CONCURRENT_PCF_TABLE_H
+#define CONCURRENT_PCF_TABLE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "bucket_table.h"
+#include "cuckoo_insert.h"
+
+//-----------------------------------------------------------------------------
+// Thread-safe perfect cuckoo filter core with lock-free reads.
+//
+// Same hash layout as PcfTable (bucket = low bits of h, fingerprint above
+// it, xor alternate bucket), over a fixed number of buckets. Buckets map
+// to lock stripes by their low bits; each stripe is one 32-bit word that
+// is both a spin lock and a seqlock version: even = unlocked, odd = a
+// writer holds it.
+//
+//  - find() takes no locks. It reads the versions of both candidate
+//    stripes, probes, reads the payload, and retries if either version
+//    changed meanwhile (or was odd).
+//  - insert() / erase() lock the two candidate stripes in index order.
+//  - When both candidates are full, insert() drops its locks, searches a
+//    kick path optimistically, then locks every stripe on the path (plus
+//    the candidates), again in index order, checks that the path is still
+//    valid and applies it; on a stale path it searches again.
+//
+// Readers look at bucket words while a writer may be changing them and
+// throw the result away if the version moved, as usual for a seqlock;
+// payloads are atomics, so the slot index itself is never torn. Payload
+// must be trivially copyable and at most eight bytes. The table does not
+// grow: size it up front (see PcfTable for the owner-only growing table).
+//-----------------------------------------------------------------------------
+
+template <typename Payload>
+class ConcurrentPcfTable {
+    static_assert(std::is_trivially_copyable<Payload>::value && sizeof(Payload) <= 8,
+                  "ConcurrentPcfTable payloads are read lock-free and must fit an atomic word");
+
+public:
+    enum InsertResult { INSERTED, DUPLICATE, FULL };
+
+    static const size_t DEFAULT_STRIPES = 4096;
+    static const int MAX_PATH_ATTEMPTS = 8;
+    static const unsigned SPINS_BEFORE_YIELD = 64;
+
+    ConcurrentPcfTable(uint32_t bucket_bits, size_t slots_per_bucket, uint32_t fingerprint_bits,
+                       size_t max_path_length = CuckooInserter::DEFAULT_MAX_PATH_LENGTH,
+                       size_t stripes = DEFAULT_STRIPES)
+        : table_(size_t(1) << bucket_bits, slots_per_bucket, fingerprint_bits + 1),
+          payloads_(new std::atomic<Payload>[table_.size() * slots_per_bucket]),
+          bucket_bits_(bucket_bits), bucket_mask_(static_cast<uint32_t>((uint64_t(1) << bucket_bits) - 1)),
+          fingerprint_mask_(static_cast<uint32_t>((uint64_t(1) << fingerprint_bits) - 1)),
+          stripe_mask_(std::min(stripes, table_.size()) - 1), stripes_(new Stripe[stripe_mask_ + 1]),
+          max_path_length_(max_path_length), kick_counts_(new std::atomic<uint64_t>[max_path_length + 1]) {
+        for (size_t i = 0; i < table_.size() * slots_per_bucket; i++) payloads_[i].store(Payload(), std::memory_order_relaxed);
+        for (size_t i = 0; i <= max_path_length; i++) kick_counts_[i].store(0, std::memory_order_relaxed);
+    }
+
+    InsertResult insert(uint32_t h, Payload payload) {
+        uint32_t b1 = bucket_of(h);
+        uint32_t fingerprint = fingerprint_of(h);
+        uint32_t b2 = alt_bucket(b1, fingerprint);
+
+        thread_local std::vector<size_t> locked;
+        lock_stripes({b1, b2}, locked);
+        InsertResult result;
+        bool done = try_insert_direct(b1, b2, fingerprint, payload, result);
+        unlock_stripes(locked);
+        if (done) return result;
+
+        // Both candidates full: find a path without locks, then lock it
+        CuckooInserter searcher(max_path_length_);
+        std::vector<CuckooInserter::PathStep> path;
+        auto alt = [this](uint32_t b, uint32_t fp) { return alt_bucket(b, fp); };
+        auto any = [](uint32_t) { return true; };
+        for (int attempt = 0; attempt < MAX_PATH_ATTEMPTS; attempt++) {
+            if (!searcher.find_path(table_, b1, b2, alt, any, path)) {
+                // Nothing within reach; an erase may still have freed b1/b2
+                lock_stripes({b1, b2}, locked);
+                done = try_insert_direct(b1, b2, fingerprint, payload, result);
+                unlock_stripes(locked);
+                if (done) return result;
+                break;
+            }
+
+            thread_local std::vector<uint32_t> buckets;
+            buckets.assign({b1, b2});
+            for (const auto& step : path) buckets.push_back(step.bucket);
+            lock_stripes(buckets, locked);
+            done = try_insert_direct(b1, b2, fingerprint, payload, result);
+            if (!done && path_valid(path)) {
+                result = apply(path, b1, fingerprint, payload);
+                done = true;
+            }
+            unlock_stripes(locked);
+            if (done) return result;
+        }
+        failures_.fetch_add(1, std::memory_order_relaxed);
+        return FULL;
+    }
+
+    // Lock-free lookup; copies the payload out
+    bool find(uint32_t h, Payload& out) const {
+        return read(h, [&out](Payload payload) { out = payload; });
+    }
+
+    bool contains(uint32_t h) const {
+        return read(h, [](Payload) {});
+    }
+
+    // Runs fn(payload) inside the optimistic read section, again on every
+    // retry; fn's results only count once read() returns true. Lets a
+    // caller copy data the payload refers to under the same version check.
+    template <typename Fn>
+    bool read(uint32_t h, Fn fn) const {
+        uint32_t b1 = bucket_of(h);
+        uint32_t fingerprint = fingerprint_of(h);
+        uint32_t b2 = alt_bucket(b1, fingerprint);
+        const Stripe& s1 = stripes_[b1 & stripe_mask_];
+        const Stripe& s2 = stripes_[b2 & stripe_mask_];
+        for (unsigned spins = 0;; spins++) {
+            uint32_t v1 = s1.version.load(std::memory_order_acquire);
+            uint32_t v2 = s2.version.load(std::memory_order_acquire);
+            if ((v1 | v2) & 1) {
+                backoff(spins);
+                continue;
+            }
+            size_t which;
+            int slot = table_.find2(b1, BucketTable::make_tag(fingerprint, false), b2,
+                                    BucketTable::make_tag(fingerprint, true), which);
+            if (slot >= 0) fn(payloads_[table_.slot_index(which, slot)].load(std::memory_order_relaxed));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s1.version.load(std::memory_order_relaxed) == v1 && s2.version.load(std::memory_order_relaxed) == v2) {
+                return slot >= 0;
+            }
+        }
+    }
+
+    bool erase(uint32_t h, Payload* removed = nullptr) {
+        uint32_t b1 = bucket_of(h);
+        uint32_t fingerprint = fingerprint_of(h);
+        uint32_t b2 = alt_bucket(b1, fingerprint);
+        thread_local std::vector<size_t> locked;
+        lock_stripes({b1, b2}, locked);
+        size_t which;
+        int slot = table_.find2(b1, BucketTable::make_tag(fingerprint, false), b2,
+                                BucketTable::make_tag(fingerprint, true), which);
+        if (slot >= 0) {
+            if (removed) *removed = payload_at(which, slot);
+            size_t moved = table_.erase(which, slot);
+            set_payload(which, slot, payload_at(which, moved));
+            entries_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        unlock_stripes(locked);
+        return slot >= 0;
+    }
+
+    size_t size() const { return entries_.load(std::memory_order_relaxed); }
+    size_t capacity() const { return table_.size() * table_.slots_per_bucket(); }
+    double load_factor() const { return static_cast<double>(size()) / capacity(); }
+    size_t bucket_count() const { return table_.size(); }
+    size_t stripe_count() const { return stripe_mask_ + 1; }
+    uint32_t tag_bits() const { return table_.tag_bits(); }
+    size_t table_bytes() const { return table_.memory_bytes(); }
+    size_t memory_bytes() const {
+        return table_.memory_bytes() + capacity() * sizeof(std::atomic<Payload>) + stripe_count() * sizeof(Stripe);
+    }
+
+    // Snapshot of the kick path lengths recorded so far
+    KickHistogram kick_histogram() const {
+        KickHistogram histogram;
+        histogram.path_lengths.resize(max_path_length_ + 1);
+        for (size_t i = 0; i <= max_path_length_; i++) {
+            histogram.path_lengths[i] = kick_counts_[i].load(std::memory_order_relaxed);
+        }
+        histogram.failures = failures_.load(std::memory_order_relaxed);
+        return histogram;
+    }
+
+private:
+    struct alignas(64) Stripe {
+        std::atomic<uint32_t> version{0};
+    };
+
+    // Spins briefly, then yields so a preempted writer can finish
+    static void backoff(unsigned spins) {
+        if (spins >= SPINS_BEFORE_YIELD) {
+            std::this_thread::yield();
+            return;
+        }
+#ifdef __SSE2__
+        _mm_pause();
+#endif
+    }
+
+    uint32_t bucket_of(uint32_t h) const { return h & bucket_mask_; }
+    uint32_t fingerprint_of(uint32_t h) const { return bucket_bits_ >= 32 ? 0 : (h >> bucket_bits_) & fingerprint_mask_; }
+    uint32_t alt_bucket(uint32_t bucket, uint32_t fingerprint) const {
+        return bucket ^ ((fingerprint * 0xCC9E2D51) & bucket_mask_);
+    }
+
+    Payload payload_at(size_t bucket, size_t slot) const {
+        return payloads_[table_.slot_index(bucket, slot)].load(std::memory_order_relaxed);
+    }
+    void set_payload(size_t bucket, size_t slot, Payload payload) {
+        payloads_[table_.slot_index(bucket, slot)].store(payload, std::memory_order_relaxed);
+    }
+
+    // Locks the stripes of `buckets` in ascending stripe order (no
+    // deadlock between writers), recording them in `locked`
+    template <typename Buckets>
+    void lock_stripes(const Buckets& buckets, std::vector<size_t>& locked) {
+        locked.clear();
+        for (uint32_t b : buckets) locked.push_back(b & stripe_mask_);
+        std::sort(locked.begin(), locked.end());
+        locked.erase(std::unique(locked.begin(), locked.end()), locked.end());
+        for (size_t s : locked) {
+            std::atomic<uint32_t>& version = stripes_[s].version;
+            for (unsigned spins = 0;; spins++) {
+                uint32_t v = version.load(std::memory_order_relaxed);
+                if (!(v & 1) && version.compare_exchange_weak(v, v + 1, std::memory_order_acquire)) break;
+                backoff(spins);
+            }
+        }
+        // Data writes must not become visible before the odd versions
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void lock_stripes(std::initializer_list<uint32_t> buckets, std::vector<size_t>& locked) {
+        lock_stripes<std::initializer_list<uint32_t>>(buckets, locked);
+    }
+
+    void unlock_stripes(const std::vector<size_t>& locked) {
+        for (size_t s : locked) stripes_[s].version.fetch_add(1, std::memory_order_release);
+    }
+
+    bool holds(const std::vector<size_t>& locked, uint32_t bucket) const {
+        return std::binary_search(locked.begin(), locked.end(), size_t(bucket & stripe_mask_));
+    }
+
+    // Duplicate check and a free slot in b1/b2; caller holds both stripes
+    bool try_insert_direct(uint32_t b1, uint32_t b2, uint32_t fingerprint, Payload payload, InsertResult& result) {
+        size_t which;
+        if (table_.find2(b1, BucketTable::make_tag(fingerprint, false), b2, BucketTable::make_tag(fingerprint, true),
+                         which) >= 0) {
+            result = DUPLICATE;
+            return true;
+        }
+        uint32_t bucket = b1;
+        int slot = table_.insert(b1, BucketTable::make_tag(fingerprint, false));
+        if (slot < 0) {
+            bucket = b2;
+            slot = table_.insert(b2, BucketTable::make_tag(fingerprint, true));
+        }
+        if (slot < 0) return false;
+        set_payload(bucket, slot, payload);
+        entries_.fetch_add(1, std::memory_order_relaxed);
+        kick_counts_[0].fetch_add(1, std::memory_order_relaxed);
+        result = INSERTED;
+        return true;
+    }
+
+    // Every step's entry still moves to the next step's bucket, and the
+    // last bucket still has room; caller holds all the path's stripes
+    bool path_valid(const std::vector<CuckooInserter::PathStep>& path) const {
+        for (size_t i = 0; i + 1 < path.size(); i++) {
+            if (path[i].slot >= table_.count(path[i].bucket)) return false;
+            uint32_t fp = BucketTable::tag_fingerprint(table_.tag(path[i].bucket, path[i].slot));
+            if (alt_bucket(path[i].bucket, fp) != path[i + 1].bucket) return false;
+        }
+        return !table_.full(path.back().bucket);
+    }
+
+    InsertResult apply(const std::vector<CuckooInserter::PathStep>& path, uint32_t b1, uint32_t fingerprint,
+                       Payload payload) {
+        uint32_t placed;
+        int slot = CuckooInserter::apply_path(
+            table_, path, b1, fingerprint,
+            [this](uint32_t fb, uint32_t fs, uint32_t tb, uint32_t ts) { set_payload(tb, ts, payload_at(fb, fs)); },
+            placed);
+        set_payload(placed, slot, payload);
+        entries_.fetch_add(1, std::memory_order_relaxed);
+        kick_counts_[std::min(path.size() - 1, max_path_length_)].fetch_add(1, std::memory_order_relaxed);
+        return INSERTED;
+    }
+
+    BucketTable table_;
+    std::unique_ptr<std::atomic<Payload>[]> payloads_;
+    uint32_t bucket_bits_;
+    uint32_t bucket_mask_;
+    uint32_t fingerprint_mask_;
+    size_t stripe_mask_;
+    std::unique_ptr<Stripe[]> stripes_;
+    size_t max_path_length_;
+    std::atomic<size_t> entries_{0};
+    std::unique_ptr<std::atomic<uint64_t>[]> kick_counts_;
+    std::atomic<uint64_t> failures_{0};
+};
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef CUCKOO_INSERT_H
+#define CUCKOO_INSERT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "bucket_table.h"
+
+//-----------------------------------------------------------------------------
+// Bounded breadth-first cuckoo insertion.
+//
+// When both candidate buckets are full, the inserter searches breadth-first
+// (as in libcuckoo) for the shortest chain of displacements that ends in a
+// bucket with a free slot, up to max_path_length kicks. Nothing is moved
+// until such a path is found, so a failed insert leaves the table exactly
+// as it was. The path is then applied from its free end backwards: each
+// entry moves to its other candidate bucket (flipping its selector bit)
+// into the slot just vacated, and the new tag takes the first slot.
+//
+// Payloads stored beside the table follow through the on_move callback,
+// called as on_move(from_bucket, from_slot, to_bucket, to_slot). The
+// optional allowed(bucket) predicate confines the search to a subset of
+// buckets, which lets several inserters work on disjoint bucket ranges
+// of one table at the same time (each needs its own CuckooInserter).
+//
+// The table is a template parameter: anything with BucketTable's tag
+// interface (insert, tag, set_tag, full, slots_per_bucket) and tag format,
+// such as FixedBucketTable in src/utxo_filter.h.
+//-----------------------------------------------------------------------------
+
+// Inserts by number of entries displaced, plus inserts that found no path
+struct KickHistogram {
+    std::vector<uint64_t> path_lengths;
+    uint64_t failures = 0;
+
+    void record(size_t length) {
+        if (length >= path_lengths.size()) path_lengths.resize(length + 1, 0);
+        path_lengths[length]++;
+    }
+
+    void merge(const KickHistogram& other) {
+        if (other.path_lengths.size() > path_lengths.size()) path_lengths.resize(other.path_lengths.size(), 0);
+        for (size_t i = 0; i < other.path_lengths.size(); i++) path_lengths[i] += other.path_lengths[i];
+        failures += other.failures;
+    }
+
+    void print(std::ostream& os) const {
+        os << "Kick path lengths:";
+        for (size_t i = 0; i < path_lengths.size(); i++) {
+            if (path_lengths[i]) os << " " << i << ":" << path_lengths[i];
+        }
+        os << " | failed: " << failures << "\n";
+    }
+};
+
+class CuckooInserter {
+public:
+    static const size_t DEFAULT_MAX_PATH_LENGTH = 5;
+    static const size_t MAX_SEARCH_NODES = 8192;
+
+    explicit CuckooInserter(size_t max_path_length = DEFAULT_MAX_PATH_LENGTH) : max_path_length_(max_path_length) {}
+
+    size_t max_path_length() const { return max_path_length_; }
+    void set_max_path_length(size_t length) { max_path_length_ = length; }
+    const KickHistogram& histogram() const { return histogram_; }
+    void merge_histogram(const KickHistogram& other) { histogram_.merge(other); }
+
+    // Places `fingerprint` in b1 (selector 0) or b2 (selector 1), kicking
+    // entries along the shortest path if both are full. Returns the slot
+    // and sets `placed` to its bucket, or returns -1 with the table
+    // untouched. alt_bucket(bucket, fingerprint) gives an entry's other
+    // candidate bucket.
+    template <typename Table, typename AltBucket, typename OnMove>
+    int insert(Table& table, uint32_t b1, uint32_t b2, uint32_t fingerprint,
+               AltBucket alt_bucket, OnMove on_move, uint32_t& placed) {
+        return insert(table, b1, b2, fingerprint, alt_bucket, on_move, [](uint32_t) { return true; }, placed);
+    }
+
+    // As above, touching only buckets for which allowed(bucket) holds;
+    // b1 must be allowed, b2 is skipped if it is not
+    template <typename Table, typename AltBucket, typename OnMove, typename Allowed>
+    int insert(Table& table, uint32_t b1, uint32_t b2, uint32_t fingerprint,
+               AltBucket alt_bucket, OnMove on_move, Allowed allowed, uint32_t& placed) {
+        bool b2_allowed = allowed(b2);
+        int slot = table.insert(b1, BucketTable::make_tag(fingerprint, false));
+        placed = b1;
+        if (slot < 0 && b2_allowed) {
+            slot = table.insert(b2, BucketTable::make_tag(fingerprint, true));
+            placed = b2;
+        }
+        if (slot >= 0) {
+            histogram_.record(0);
+            return slot;
+        }
+
+        if (!find_path(table, b1, b2_allowed ? b2 : b1, alt_bucket, allowed, path_)) {
+            histogram_.failures++;
+            return -1;
+        }
+        slot = apply_path(table, path_, b1, fingerprint, on_move, placed);
+        histogram_.record(path_.size() - 1);
+        return slot;
+    }
+
+    // One hop of a displacement path: the entry in `slot` of `bucket` moves
+    // to the next step's bucket. The last step names a bucket with room.
+    struct PathStep {
+        uint32_t bucket;
+        uint32_t slot;
+    };
+
+    // Shortest path (root first) from b1 or b2 to a bucket with a free
+    // slot, through allowed buckets only. Reads the table but does not
+    // change it, so it can run ahead of taking the locks the path needs.
+    template <typename Table, typename AltBucket, typename Allowed>
+    bool find_path(const Table& table, uint32_t b1, uint32_t b2, AltBucket alt_bucket, Allowed allowed,
+                   std::vector<PathStep>& path) {
+        size_t leaf;
+        if (!search(table, b1, b2, alt_bucket, allowed, leaf)) return false;
+        path.clear();
+        path.push_back({nodes_[leaf].bucket, 0});
+        for (size_t n = leaf; nodes_[n].parent >= 0; n = nodes_[n].parent) {
+            path.push_back({nodes_[nodes_[n].parent].bucket, nodes_[n].parent_slot});
+        }
+        std::reverse(path.begin(), path.end());
+        return true;
+    }
+
+    // Applies `path` leaf -> root, moving each entry into the hole below it,
+    // and stores `fingerprint` in the freed root slot (selector set unless
+    // the root is b1). Returns that slot; `placed` is the root bucket.
+    template <typename Table, typename OnMove>
+    static int apply_path(Table& table, const std::vector<PathStep>& path, uint32_t b1, uint32_t fingerprint,
+                          OnMove on_move, uint32_t& placed) {
+        uint32_t to_bucket = path.back().bucket;
+        int to_slot = -1;
+        if (path.size() == 1) {
+            placed = to_bucket;
+            return table.insert(to_bucket, BucketTable::make_tag(fingerprint, to_bucket != b1));
+        }
+        for (size_t i = path.size() - 1; i > 0; i--) {
+            const PathStep& from = path[i - 1];
+            uint32_t tag = table.tag(from.bucket, from.slot) ^ 1;
+            if (to_slot < 0) {
+                to_slot = table.insert(to_bucket, tag);
+            } else {
+                table.set_tag(to_bucket, to_slot, tag);
+            }
+            on_move(from.bucket, from.slot, to_bucket, static_cast<uint32_t>(to_slot));
+            to_bucket = from.bucket;
+            to_slot = static_cast<int>(from.slot);
+        }
+        placed = to_bucket;
+        table.set_tag(to_bucket, to_slot, BucketTable::make_tag(fingerprint, to_bucket != b1));
+        return to_slot;
+    }
+
+private:
+    struct Node {
+        uint32_t bucket;
+        int32_t parent;       // index into nodes_, -1 for the two roots
+        uint32_t parent_slot; // slot in the parent whose entry moves here
+        uint32_t depth;
+    };
+
+    template <typename Table, typename AltBucket, typename Allowed>
+    bool search(const Table& table, uint32_t b1, uint32_t b2, AltBucket alt_bucket, Allowed allowed,
+                size_t& leaf) {
+        nodes_.clear();
+        nodes_.push_back({b1, -1, 0, 0});
+        if (b2 != b1) nodes_.push_back({b2, -1, 0, 0});
+        for (size_t head = 0; head < nodes_.size(); head++) {
+            Node node = nodes_[head];
+            if (!table.full(node.bucket)) {
+                leaf = head;
+                return true;
+            }
+            if (node.depth == max_path_length_) continue;
+            for (size_t slot = 0; slot < table.slots_per_bucket() && nodes_.size() < MAX_SEARCH_NODES; slot++) {
+                uint32_t fp = BucketTable::tag_fingerprint(table.tag(node.bucket, slot));
+                uint32_t next = alt_bucket(node.bucket, fp);
+                if (!allowed(next) || on_path(head, next)) continue;
+                nodes_.push_back({next, static_cast<int32_t>(head), static_cast<uint32_t>(slot), node.depth + 1});
+            }
+        }
+        return false;
+    }
+
+    // A path must not revisit a bucket, or in-place moves would clash
+    bool on_path(size_t n, uint32_t bucket) const {
+        for (int32_t i = static_cast<int32_t>(n); i >= 0; i = nodes_[i].parent) {
+            if (nodes_[i].bucket == bucket) return true;
+        }
+        return false;
+    }
+
+    size_t max_path_length_;
+    std::vector<Node> nodes_;
+    std::vector<PathStep> path_;
+    KickHistogram histogram_;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef HASHERS_H
+#define HASHERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#include "crc.h"
+#include "murmur3.h"
+
+//-----------------------------------------------------------------------------
+// Hasher policies for UTXOManager.
+//
+// A hasher maps key bytes to one 32-bit value h. The manager takes the
+// bucket index from the low bits of h and the fingerprint from the bits
+// above it, so (bucket, fingerprint) is exactly h and two keys share a
+// slot only if their 32-bit hashes are equal. Restricted to 4-byte inputs
+// every hasher below is a bijection of the 32-bit universe (CRCs are
+// invertible linear maps of a 32-bit register, Murmur3 is a chain of
+// invertible mixes), which is the property the PCF design relies on; for
+// longer keys they behave as uniform 32-bit hashes.
+//-----------------------------------------------------------------------------
+
+// Reference bit-at-a-time CRC32 (reflected 0xEDB88320), as originally used
+// by the managers. Kept for comparisons; produces the same values as
+// Crc32Hasher.
+struct BitwiseCrc32Hasher {
+    static const char* name() { return "crc32-bitwise"; }
+
+    uint32_t operator()(const void* key, size_t len) const {
+        const uint32_t polynomial = 0xEDB88320;
+        const uint8_t* p = static_cast<const uint8_t*>(key);
+        uint32_t crc = 0xFFFFFFFF;
+        for (size_t i = 0; i < len; i++) {
+            crc ^= p[i];
+            for (int j = 0; j < 8; j++) {
+                crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+            }
+        }
+        return ~crc;
+    }
+};
+
+// Table-driven CRC32 from src/crc.cpp (zlib). Bit-identical to the bitwise
+// loop, so filters built with either map every key to the same slot.
+struct Crc32Hasher {
+    static const char* name() { return "crc32-table"; }
+
+    uint32_t operator()(const void* key, size_t len) const {
+        return crc32(key, static_cast<int>(len), 0);
+    }
+};
+
+// CRC32C (Castagnoli). Uses the SSE4.2 crc32 instruction, eight bytes per
+// step, when the target has it and a bitwise loop otherwise. Note CRC32C
+// is a different polynomial from CRC32, so it places keys differently.
+struct Crc32cHasher {
+    static const char* name() { return "crc32c"; }
+
+    uint32_t operator()(const void* key, size_t len) const {
+        const uint8_t* p = static_cast<const uint8_t*>(key);
+        uint32_t crc = 0xFFFFFFFF;
+#ifdef __SSE4_2__
+        uint64_t crc64 = crc;
+        for (; len >= 8; p += 8, len -= 8) {
+            uint64_t block;
+            std::memcpy(&block, p, sizeof(block));
+            crc64 = _mm_crc32_u64(crc64, block);
+        }
+        crc = static_cast<uint32_t>(crc64);
+        for (; len > 0; p++, len--) crc = _mm_crc32_u8(crc, *p);
+#else
+        for (; len > 0; p++, len--) {
+            crc ^= *p;
+            for (int j = 0; j < 8; j++) {
+                crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78 : 0);
+            }
+        }
+#endif
+        return ~crc;
+    }
+};
+
+// MurmurHash3 x86_32 from src/murmur3.h.
+struct Murmur3Hasher {
+    static const char* name() { return "murmur3"; }
+
+    uint32_t operator()(const void* key, size_t len) const {
+        uint32_t h;
+        MurmurHash3_x86_32(key, static_cast<int>(len), 0, &h);
+        return h;
+    }
+};
+
+// A hasher for one shard of a table split by the top SHARD_BITS bits of
+// Hasher's value: the shard sees the remaining low bits, so it needs
+// bucket bits + fingerprint bits = 32 - SHARD_BITS to keep (shard,
+// bucket, fingerprint) exactly equal to the full hash.
+template <typename Hasher, uint32_t SHARD_BITS>
+struct ShardLocalHasher {
+    static const uint32_t SHARD_SHIFT = 32 - SHARD_BITS;
+    static const char* name() { return Hasher::name(); }
+
+    static uint32_t shard_of(uint32_t h) { return SHARD_BITS ? h >> SHARD_SHIFT : 0; }
+
+    uint32_t operator()(const void* key, size_t len) const {
+        return SHARD_BITS ? hasher(key, len) & ((uint32_t(1) << SHARD_SHIFT) - 1) : hasher(key, len);
+    }
+
+    Hasher hasher;
+};
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef MEMORY_POLICY_H
+#define MEMORY_POLICY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "numa_topology.h"
+
+//-----------------------------------------------------------------------------
+// Page size and NUMA placement of the large arrays: bucket tables, their
+// payloads and the value slab.
+//
+// The default policy is plain aligned operator new. Any other policy maps
+// anonymous memory:
+//   - TRANSPARENT_HUGE_PAGES: 2 MB aligned, madvise(MADV_HUGEPAGE);
+//   - HUGE_2MB / HUGE_1GB: MAP_HUGETLB from the reserved pool
+//     (/proc/sys/vm/nr_hugepages, or the 1 GB pool); falls back to
+//     transparent huge pages when the pool is short;
+//   - placement INTERLEAVE or BIND over `nodes` (a node bitmask, 0 = every
+//     online node), set with mbind() before the first touch;
+//     FIRST_TOUCH leaves it to the thread that first writes a page;
+//   - prefault: every page is written once at allocation, so faults (and
+//     huge page zeroing) happen at startup instead of on the first probes.
+// Requests under MIN_MAPPED_BYTES go to operator new all the same.
+//
+// PolicyMemory::allocate() keeps the mapping length in a 64-byte header in
+// front of the block, so release() needs only the pointer, and blocks stay
+// 64-byte aligned. PolicyAllocator<T> wraps it for std::vector. Counters
+// of huge page fallbacks and mapped bytes are global, for the benchmarks.
+//-----------------------------------------------------------------------------
+
+struct MemoryPolicy {
+    enum Pages { SMALL_PAGES, TRANSPARENT_HUGE_PAGES, HUGE_2MB, HUGE_1GB };
+    enum Placement { FIRST_TOUCH, INTERLEAVE, BIND };
+
+    Pages pages = SMALL_PAGES;
+    Placement placement = FIRST_TOUCH;
+    uint64_t nodes = 0; // bit n = NUMA node n; 0 = all
+    bool prefault = false;
+
+    bool is_default() const { return pages == SMALL_PAGES && placement == FIRST_TOUCH && !prefault; }
+
+    // "small", "thp", "2m" or "1g"
+    static bool parse_pages(const std::string& name, Pages& pages) {
+        static const char* const NAMES[] = {"small", "thp", "2m", "1g"};
+        for (int p = 0; p <= HUGE_1GB; p++) {
+            if (name == NAMES[p]) {
+                pages = Pages(p);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // "first-touch", "interleave" or "bind"
+    static bool parse_placement(const std::string& name, Placement& placement) {
+        static const char* const NAMES[] = {"first-touch", "interleave", "bind"};
+        for (int p = 0; p <= BIND; p++) {
+            if (name == NAMES[p]) {
+                placement = Placement(p);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // e.g. "thp+interleave+prefault"
+    std::string name() const {
+        static const char* const PAGES[] = {"small", "thp", "2m", "1g"};
+        static const char* const PLACEMENTS[] = {"", "+interleave", "+bind"};
+        return std::string(PAGES[pages]) + PLACEMENTS[placement] + (prefault ? "+prefault" : "");
+    }
+};
+
+class PolicyMemory {
+public:
+    static const size_t HEADER = 64;
+    static const size_t SMALL_PAGE = 4096;
+    static const size_t HUGE_PAGE = size_t(1) << 21;
+    static const size_t GIANT_PAGE = size_t(1) << 30;
+    static const size_t MIN_MAPPED_BYTES = size_t(1) << 20;
+
+    // 64-byte aligned; throws std::bad_alloc rather than returning null
+    static void* allocate(size_t bytes, const MemoryPolicy& policy) {
+        if (policy.is_default()) return ::operator new(bytes, std::align_val_t(HEADER));
+        size_t total = bytes + HEADER;
+        char* base;
+        size_t mapped = 0;
+        if (total < MIN_MAPPED_BYTES) {
+            base = static_cast<char*>(::operator new(total, std::align_val_t(HEADER)));
+        } else {
+            base = map(total, policy, mapped);
+        }
+        *reinterpret_cast<size_t*>(base) = mapped;
+        return base + HEADER;
+    }
+
+    // allocate(), cleared; fresh mappings are zero already and are left
+    // untouched, so pages are only faulted where the policy says
+    static void* allocate_zeroed(size_t bytes, const MemoryPolicy& policy) {
+        if (policy.is_default()) return std::memset(allocate(bytes, policy), 0, bytes);
+        void* block = allocate(bytes, policy);
+        if (!*reinterpret_cast<size_t*>(static_cast<char*>(block) - HEADER)) std::memset(block, 0, bytes);
+        return block;
+    }
+
+    static void release(void* block, const MemoryPolicy& policy) {
+        if (!block) return;
+        if (policy.is_default()) return ::operator delete(block, std::align_val_t(HEADER));
+        char* base = static_cast<char*>(block) - HEADER;
+        size_t mapped = *reinterpret_cast<size_t*>(base);
+        if (mapped) {
+            munmap(base, mapped);
+            counters().mapped_bytes.fetch_sub(mapped, std::memory_order_relaxed);
+        } else {
+            ::operator delete(base, std::align_val_t(HEADER));
+        }
+    }
+
+    struct Counters {
+        std::atomic<size_t> mapped_bytes{0};        // currently mapped under non-default policies
+        std::atomic<size_t> huge_page_fallbacks{0}; // MAP_HUGETLB requests served by THP instead
+        std::atomic<size_t> placement_failures{0};  // mbind() refused (e.g. no such node)
+    };
+
+    static Counters& counters() {
+        static Counters c;
+        return c;
+    }
+
+private:
+    static char* map(size_t total, const MemoryPolicy& policy, size_t& mapped) {
+        void* p = MAP_FAILED;
+        if (policy.pages == MemoryPolicy::HUGE_2MB || policy.pages == MemoryPolicy::HUGE_1GB) {
+            bool giant = policy.pages == MemoryPolicy::HUGE_1GB;
+            mapped = round_up(total, giant ? GIANT_PAGE : HUGE_PAGE);
+            int size_flag = (giant ? 30 : 21) << MAP_HUGE_SHIFT;
+            p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag, -1, 0);
+            if (p == MAP_FAILED) counters().huge_page_fallbacks.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (p == MAP_FAILED) {
+            bool huge = policy.pages != MemoryPolicy::SMALL_PAGES;
+            mapped = round_up(total, huge ? HUGE_PAGE : SMALL_PAGE);
+            p = huge ? map_aligned(mapped, HUGE_PAGE)
+                     : mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) throw std::bad_alloc();
+            if (huge) madvise(p, mapped, MADV_HUGEPAGE);
+        }
+        if (policy.placement != MemoryPolicy::FIRST_TOUCH && !bind(p, mapped, policy)) {
+            counters().placement_failures.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (policy.prefault) {
+            volatile char* bytes = static_cast<char*>(p);
+            for (size_t offset = 0; offset < mapped; offset += SMALL_PAGE) bytes[offset] = 0;
+        }
+        counters().mapped_bytes.fetch_add(mapped, std::memory_order_relaxed);
+        return static_cast<char*>(p);
+    }
+
+    // Transparent huge pages only back 2 MB aligned ranges: maps `align`
+    // more than asked and trims both ends
+    static void* map_aligned(size_t bytes, size_t align) {
+        void* p = mmap(nullptr, bytes + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return p;
+        uintptr_t start = reinterpret_cast<uintptr_t>(p);
+        uintptr_t aligned = (start + align - 1) & ~uintptr_t(align - 1);
+        if (aligned > start) munmap(p, aligned - start);
+        size_t tail = start + align - aligned;
+        if (tail) munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    // mbind(2) directly, without libnuma; modes from <linux/mempolicy.h>
+    static bool bind(void* p, size_t bytes, const MemoryPolicy& policy) {
+        const int MPOL_BIND_MODE = 2, MPOL_INTERLEAVE_MODE = 3;
+        unsigned long mask = policy.nodes ? static_cast<unsigned long>(policy.nodes) : online_nodes();
+        int mode = policy.placement == MemoryPolicy::BIND ? MPOL_BIND_MODE : MPOL_INTERLEAVE_MODE;
+        return syscall(SYS_mbind, p, bytes, mode, &mask, sizeof(mask) * 8, 0) == 0;
+    }
+
+    static unsigned long online_nodes() {
+        unsigned long mask = 0;
+        for (int node : NumaTopology::online_nodes()) {
+            if (node >= 0 && node < 64) mask |= 1ul << node;
+        }
+        return mask ? mask : 1;
+    }
+
+    static size_t round_up(size_t bytes, size_t page) { return (bytes + page - 1) / page * page; }
+};
+
+// std::vector allocator over PolicyMemory
+template <typename T>
+class PolicyAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    PolicyAllocator() = default;
+    explicit PolicyAllocator(const MemoryPolicy& policy) : policy_(policy) {}
+    template <typename U>
+    PolicyAllocator(const PolicyAllocator<U>& other) : policy_(other.policy()) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(PolicyMemory::allocate(n * sizeof(T), policy_)); }
+    void deallocate(T* p, size_t) { PolicyMemory::release(p, policy_); }
+
+    const MemoryPolicy& policy() const { return policy_; }
+
+    template <typename U>
+    bool operator==(const PolicyAllocator<U>& other) const { return same(policy_, other.policy()); }
+    template <typename U>
+    bool operator!=(const PolicyAllocator<U>& other) const { return !(*this == other); }
+
+private:
+    static bool same(const MemoryPolicy& a, const MemoryPolicy& b) {
+        return a.pages == b.pages && a.placement == b.placement && a.nodes == b.nodes && a.prefault == b.prefault;
+    }
+
+    MemoryPolicy policy_;
+};
+
+#endif
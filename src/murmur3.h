@@ -112,8 +112,8 @@ void MurmurHash3_x86_32(const void * key, int len, uint32_t seed, void * out) {
 
 		switch (len & 3)
 		{
-		case 3: k1 ^= tail[2] << 16;
-		case 2: k1 ^= tail[1] << 8;
+		case 3: k1 ^= tail[2] << 16; [[fallthrough]];
+		case 2: k1 ^= tail[1] << 8; [[fallthrough]];
 		case 1: k1 ^= tail[0];
 			k1 *= c1; k1 = ROTL32(k1, 15); k1 *= c2; h1 ^= k1;
 		};
@@ -0,0 +1,81 @@
+#ifndef NUMA_TOPOLOGY_H
+#define NUMA_TOPOLOGY_H
+
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+//-----------------------------------------------------------------------------
+// NUMA nodes and their CPUs, read from /sys/devices/system/node.
+//
+// No libnuma: memory is placed by the kernel's default first-touch policy,
+// so a thread pinned to a node's CPUs that allocates and first writes a
+// structure gets it in that node's memory. Without the sysfs tree (non-NUMA
+// kernels, containers) everything is one node holding every hardware
+// thread.
+//-----------------------------------------------------------------------------
+
+struct NumaTopology {
+    std::vector<std::vector<int>> node_cpus; // online CPUs of each node with any
+
+    static NumaTopology detect() {
+        NumaTopology topology;
+        for (int node : online_nodes()) {
+            std::vector<int> cpus =
+                parse_cpu_list(read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+            if (!cpus.empty()) topology.node_cpus.push_back(cpus);
+        }
+        if (topology.node_cpus.empty()) {
+            unsigned n = std::thread::hardware_concurrency();
+            topology.node_cpus.emplace_back();
+            for (unsigned cpu = 0; cpu < (n ? n : 1); cpu++) topology.node_cpus[0].push_back(static_cast<int>(cpu));
+        }
+        return topology;
+    }
+
+    size_t nodes() const { return node_cpus.size(); }
+
+    // Node numbers the kernel lists as online; empty without the sysfs tree
+    static std::vector<int> online_nodes() { return parse_cpu_list(read_line("/sys/devices/system/node/online")); }
+
+    // "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}; used for node lists too
+    static std::vector<int> parse_cpu_list(const std::string& list) {
+        std::vector<int> cpus;
+        std::stringstream ranges(list);
+        std::string range;
+        while (std::getline(ranges, range, ',')) {
+            if (range.empty()) continue;
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+private:
+    static std::string read_line(const std::string& path) {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+};
+
+// Restricts the calling thread to `cpus`; false if the kernel refuses
+inline bool pin_current_thread(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef OUTPOINT_H
+#define OUTPOINT_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+//-----------------------------------------------------------------------------
+// Binary UTXO key: 32-byte txid + output index, hashed and compared as raw
+// bytes so the manager hot path never touches heap strings.
+//
+// The txid bytes are stored in the order they appear in the hex text (no
+// reversal). Shorter even-length hex txids, as produced by the synthetic
+// benchmarks, fill the leading bytes and leave the rest zero.
+//-----------------------------------------------------------------------------
+
+struct OutPoint {
+    uint8_t txid[32];
+    uint32_t vout;
+
+    OutPoint() : txid(), vout(0) {}
+
+    bool operator==(const OutPoint& other) const {
+        return vout == other.vout && std::memcmp(txid, other.txid, sizeof(txid)) == 0;
+    }
+    bool operator!=(const OutPoint& other) const { return !(*this == other); }
+};
+
+static_assert(sizeof(OutPoint) == 36, "OutPoint must have no padding: it is hashed as raw bytes");
+
+// For unordered containers; the txid is already uniformly distributed
+struct OutPointHasher {
+    size_t operator()(const OutPoint& key) const {
+        uint64_t head;
+        std::memcpy(&head, key.txid, sizeof(head));
+        return head ^ (static_cast<uint64_t>(key.vout) * 0x9E3779B97F4A7C15ull);
+    }
+};
+
+// Hex digit value, or -1
+inline int hex_digit_value(char c) {
+    static const struct HexTable {
+        int8_t v[256];
+        HexTable() {
+            for (int i = 0; i < 256; i++) v[i] = -1;
+            for (int i = 0; i < 10; i++) v['0' + i] = i;
+            for (int i = 0; i < 6; i++) v['a' + i] = v['A' + i] = 10 + i;
+        }
+    } table;
+    return table.v[static_cast<uint8_t>(c)];
+}
+
+// Decodes `len` hex chars (even) into len / 2 bytes. False on a bad digit.
+inline bool decode_hex(const char* hex, size_t len, uint8_t* out) {
+    if (len & 1) return false;
+    for (size_t i = 0; i < len; i += 2) {
+        int hi = hex_digit_value(hex[i]);
+        int lo = hex_digit_value(hex[i + 1]);
+        if ((hi | lo) < 0) return false;
+        out[i / 2] = static_cast<uint8_t>((hi << 4) | lo);
+    }
+    return true;
+}
+
+// Parses "txid:index". Surrounding quotes and spaces, as left in place by
+// the CSV splitter, are ignored.
+inline bool parse_outpoint(std::string_view text, OutPoint& out) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\'' || text.front() == '"')) text.remove_prefix(1);
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\'' || text.back() == '"' || text.back() == '\r')) {
+        text.remove_suffix(1);
+    }
+    size_t colon = text.find(':');
+    if (colon == std::string_view::npos || colon == 0 || colon > 2 * sizeof(out.txid)) return false;
+
+    OutPoint result;
+    if (!decode_hex(text.data(), colon, result.txid)) return false;
+    const char* first = text.data() + colon + 1;
+    const char* last = text.data() + text.size();
+    auto parsed = std::from_chars(first, last, result.vout);
+    if (parsed.ec != std::errc() || parsed.ptr != last || first == last) return false;
+    out = result;
+    return true;
+}
+
+inline std::string to_string(const OutPoint& key) {
+    static const char hex_digits[] = "0123456789abcdef";
+    std::string text;
+    text.reserve(2 * sizeof(key.txid) + 11);
+    for (uint8_t byte : key.txid) {
+        text += hex_digits[byte >> 4];
+        text += hex_digits[byte & 15];
+    }
+    text += ':';
+    text += std::to_string(key.vout);
+    return text;
+}
+
+#endif
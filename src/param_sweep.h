@@ -0,0 +1,230 @@
+#ifndef PARAM_SWEEP_H
+#define PARAM_SWEEP_H
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "bench_harness.h"
+#include "cuckoo_insert.h"
+#include "hashers.h"
+#include "outpoint.h"
+#include "utxo_filter.h"
+
+//-----------------------------------------------------------------------------
+// Parallel runner for the filter parameter sweeps (rst2, Memory_Optimization).
+//
+// A sweep is a grid of independent cells, e.g. filter geometry x layout x
+// UTXO count, each building its own filter from scratch. run_sweep() runs
+// cell(i) for every i in [0, cells) on a pool of worker threads that take
+// the next index from a shared counter, so long cells do not hold up the
+// short ones, and returns the results in cell order. done(i, result) is
+// called as each cell finishes, one call at a time, for progress output.
+//
+// Cells only read what they share (the pre-generated keys); every cell
+// owns its filters, so the results do not depend on the thread count or
+// on the order cells run in. Every worker holds one cell's structures at a
+// time: peak memory is about `threads` times that of the largest cell.
+// An exception from a cell stops the other workers at their next cell and
+// is rethrown by run_sweep().
+//
+// The filter sweeps share the rest. A SweepCell is one filter geometry and
+// layout, filled from a prefix of the keys; run_sweep_cell() fills a fresh
+// PCF manager and a fresh baseline for one and measures their FPR and heap
+// bytes. run_filter_sweep() runs a grid of cells with progress output and
+// write_sweep_csv() writes the rows; the programs supply the manager types
+// and the grid. Pulls in src/alloc_counter.h, which replaces the global
+// operator new: include this in a program's one translation unit.
+//-----------------------------------------------------------------------------
+
+// Workers for `requested` threads; 0 = one per hardware thread
+inline size_t sweep_threads(size_t requested) {
+    if (requested) return requested;
+    size_t hardware = std::thread::hardware_concurrency();
+    return hardware ? hardware : 1;
+}
+
+template <typename Result, typename Cell, typename Done>
+std::vector<Result> run_sweep(size_t cells, size_t threads, Cell cell, Done done) {
+    std::vector<Result> results(cells);
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex lock; // done() calls and error
+
+    auto work = [&] {
+        for (size_t i; !failed.load(std::memory_order_relaxed) && (i = next.fetch_add(1)) < cells;) {
+            try {
+                results[i] = cell(i);
+                std::lock_guard<std::mutex> guard(lock);
+                done(i, results[i]);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(lock);
+                if (!error) error = std::current_exception();
+                failed = true;
+            }
+        }
+    };
+
+    threads = sweep_threads(threads);
+    if (threads > cells) threads = cells ? cells : 1;
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; t++) workers.emplace_back(work);
+    work();
+    for (std::thread& worker : workers) worker.join();
+    if (error) std::rethrow_exception(error);
+    return results;
+}
+
+// Parses the sweep programs' only option, [--threads N]; false (after
+// printing the usage) on anything else
+inline bool parse_sweep_args(int argc, char** argv, size_t& threads) {
+    threads = 0;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--threads" && i + 1 < argc) {
+            threads = std::stoull(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--threads N]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// One grid point: a filter geometry and layout, filled from count keys
+struct SweepCell {
+    size_t num_buckets;
+    uint32_t fingerprint_bits;
+    bool blocked;
+    size_t count;
+};
+
+struct SweepRow {
+    bool dispatched = false;
+    size_t inserted = 0;
+    double pcf_fpr = 0;
+    double core_fpr = 0;
+    double pcf_memory_mb = 0;  // measured: live heap bytes of each manager after the fill
+    double core_memory_mb = 0;
+    KickHistogram kicks;
+};
+
+// Every (buckets, fingerprint bits) config in both layouts (flat: alternate
+// bucket anywhere; blocked: within the primary's cache line pair) at every count
+inline std::vector<SweepCell> sweep_grid(const std::vector<std::pair<size_t, uint32_t>>& filter_configs,
+                                         const std::vector<size_t>& utxo_counts) {
+    std::vector<SweepCell> cells;
+    for (const auto& config : filter_configs) {
+        for (bool blocked : {false, true}) {
+            for (size_t count : utxo_counts) cells.push_back({config.first, config.second, blocked, count});
+        }
+    }
+    return cells;
+}
+
+// Measure FPR over keys that were never inserted
+template <typename Manager>
+double measure_fpr(const Manager& manager, const std::vector<OutPoint>& absent_keys) {
+    size_t false_positives = 0;
+    for (const OutPoint& key : absent_keys) {
+        if (manager.get_utxo(key)) false_positives++;
+    }
+    return static_cast<double>(false_positives) / absent_keys.size();
+}
+
+// Fills a fresh Pcf<Filter> (Filter: the UTXOFilter for the cell's geometry
+// with Payload per slot) and a fresh Core manager from keys.present[0, count),
+// stopping at 90% load. Values are Value(coinbase, height, amount) with
+// random fields drawn from `seed`; a key counts as inserted once both
+// managers took it.
+template <template <typename> class Pcf, typename Core, typename Payload, typename Value>
+SweepRow run_sweep_cell(const SweepCell& cell, size_t slots_per_bucket, const BenchKeys& keys, uint64_t seed) {
+    SweepRow row;
+    std::mt19937_64 rng(seed);
+    uint32_t bucket_bits = static_cast<uint32_t>(std::ceil(std::log2(cell.num_buckets)));
+    row.dispatched = with_utxo_filter<Crc32Hasher, Payload>(
+        bucket_bits, cell.fingerprint_bits, slots_per_bucket, cell.blocked, [&](auto filter_type) {
+            using Filter = typename decltype(filter_type)::type;
+            AllocationAccount pcf_bytes, core_bytes;
+            std::unique_ptr<Pcf<Filter>> pcf_manager;
+            std::unique_ptr<Core> core_manager;
+            {
+                ChargeTo charge(pcf_bytes);
+                pcf_manager.reset(new Pcf<Filter>());
+            }
+            {
+                ChargeTo charge(core_bytes);
+                core_manager.reset(new Core());
+            }
+
+            for (size_t i = 0; i < cell.count; i++) {
+                if (pcf_manager->get_load_factor() >= 0.90) break;
+                Value value(true, rng() % 1000000, rng() % 100000000);
+                bool added;
+                {
+                    ChargeTo charge(pcf_bytes);
+                    added = pcf_manager->add_utxo(keys.present[i], value);
+                }
+                ChargeTo charge(core_bytes);
+                if (added && core_manager->add_utxo(keys.present[i], value)) row.inserted++;
+            }
+
+            row.pcf_fpr = measure_fpr(*pcf_manager, keys.absent);
+            row.core_fpr = 0.0;
+            row.pcf_memory_mb = pcf_bytes.megabytes();
+            row.core_memory_mb = core_bytes.megabytes();
+            row.kicks = pcf_manager->kick_histogram();
+        });
+    return row;
+}
+
+// Runs cell_fn(cell, seed) over the grid on `threads` threads (0 = one per
+// core), printing each row as it finishes; rows come back in grid order
+template <typename CellFn>
+std::vector<SweepRow> run_filter_sweep(const std::vector<SweepCell>& cells, size_t threads, uint64_t seed,
+                                       CellFn cell_fn) {
+    threads = sweep_threads(threads);
+    std::cout << "Running " << cells.size() << " configurations on " << threads << " threads...\n";
+    return run_sweep<SweepRow>(
+        cells.size(), threads, [&](size_t i) { return cell_fn(cells[i], seed + i + 1); },
+        [&](size_t i, const SweepRow& row) {
+            const SweepCell& cell = cells[i];
+            if (!row.dispatched) {
+                std::cerr << "No UTXOFilter specialization for " << cell.num_buckets << " buckets, "
+                          << cell.fingerprint_bits << " fingerprint bits\n";
+                return;
+            }
+            std::cout << cell.count << " UTXOs, " << cell.num_buckets << " buckets, " << cell.fingerprint_bits
+                      << " fingerprint bits, " << (cell.blocked ? "blocked" : "flat") << ": inserted " << row.inserted
+                      << ", PCF FPR: " << row.pcf_fpr * 100 << "%, Core FPR: " << row.core_fpr * 100
+                      << "%, PCF Memory: " << row.pcf_memory_mb << " MB, Core Memory: " << row.core_memory_mb
+                      << " MB\n";
+            row.kicks.print(std::cout);
+        });
+}
+
+// Header and one line per dispatched cell, in grid order
+inline void write_sweep_csv(std::ostream& out, const std::vector<SweepCell>& cells, const std::vector<SweepRow>& rows) {
+    out << "Filter_Size,Fingerprint_Bits,Layout,UTXO_Count,PCF_FPR,Core_FPR,PCF_Memory_MB,Core_Memory_MB\n";
+    for (size_t i = 0; i < cells.size(); i++) {
+        const SweepCell& cell = cells[i];
+        const SweepRow& row = rows[i];
+        if (!row.dispatched) continue;
+        out << cell.num_buckets << "," << cell.fingerprint_bits << "," << (cell.blocked ? "blocked" : "flat") << ","
+            << row.inserted << "," << row.pcf_fpr << "," << row.core_fpr << "," << row.pcf_memory_mb << ","
+            << row.core_memory_mb << "\n";
+    }
+}
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef PCF_SNAPSHOT_H
+#define PCF_SNAPSHOT_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pcf_table.h"
+#include "value_slab.h"
+
+//-----------------------------------------------------------------------------
+// Binary snapshot of a PcfTable<uint32_t> + ValueSlab manager.
+//
+// Layout: a fixed SnapshotHeader, then four sections, each starting on a
+// 64-byte boundary:
+//
+//   packed bucket words      exactly BucketTable::data()
+//   slot payloads            uint32_t slab index per slot
+//   slab records             ByteSpan per slab index
+//   slab arena               encoded values (src/utxo_codec.h)
+//
+// Everything is in host byte order; the header records the byte order,
+// format version, geometry, hasher name, best block height and the last
+// write-ahead log record included (src/utxo_wal.h), and open() rejects a
+// file that does not match. Sections are written with
+// plain bulk write() calls to "<path>.tmp", which is then renamed over the
+// target, so a crash leaves either the old or the new snapshot.
+//
+// SnapshotFile maps a snapshot privately with read/write access. The
+// table and slab are constructed straight over the mapped sections (the
+// borrowing constructors of PcfTable and ValueSlab), so start-up costs
+// only the page faults of the pages actually touched. Pages that are
+// never written stay shared with the page cache, and with every other
+// process that maps the same file; a write copies just that page.
+//-----------------------------------------------------------------------------
+
+struct SnapshotHeader {
+    static const uint32_t VERSION = 5; // 2: log_sequence, 3: alternate_entries, 4: block_bits, 5: 40-bit ByteSpan offsets
+    static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static const size_t HASHER_NAME_BYTES = 32;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t bucket_bits;
+    uint32_t slots_per_bucket;
+    uint32_t fingerprint_bits;
+    uint32_t tag_bits;
+    uint32_t block_bits; // PcfTable::set_block_bits(), 0 = unblocked
+    uint64_t words_per_bucket;
+    uint64_t entries;
+    uint64_t alternate_entries; // entries held in their alternate bucket
+    uint64_t best_height;
+    uint64_t log_sequence; // last write-ahead log record included (src/utxo_wal.h)
+    char hasher[HASHER_NAME_BYTES];
+    uint64_t table_offset, table_bytes;
+    uint64_t payload_offset, payload_bytes;
+    uint64_t records_offset, record_count;
+    uint64_t arena_offset, arena_bytes;
+    uint64_t live_values, dead_bytes;
+    uint64_t file_bytes;
+};
+
+static const char SNAPSHOT_MAGIC[8] = {'P', 'C', 'F', 'S', 'N', 'A', 'P', '\0'};
+
+inline uint64_t snapshot_align(uint64_t offset) { return (offset + BucketTable::CACHE_LINE - 1) & ~uint64_t(BucketTable::CACHE_LINE - 1); }
+
+// Writes `table` (which must not be migrating) and `values`; false with
+// `error` set on failure
+inline bool write_snapshot(const std::string& path, const PcfTable<uint32_t>& table, const ValueSlab& values,
+                           const char* hasher, uint64_t best_height, uint64_t log_sequence, std::string& error) {
+    if (table.migrating()) {
+        error = "table is still migrating";
+        return false;
+    }
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SnapshotHeader::VERSION;
+    header.byte_order = SnapshotHeader::BYTE_ORDER_MARK;
+    header.bucket_bits = table.bucket_bits();
+    header.slots_per_bucket = static_cast<uint32_t>(table.slots_per_bucket());
+    header.fingerprint_bits = table.fingerprint_bits();
+    header.tag_bits = table.tag_bits();
+    header.block_bits = table.block_bits();
+    header.words_per_bucket = table.words_per_bucket();
+    header.entries = table.count();
+    header.alternate_entries = table.alternate_entries();
+    header.best_height = best_height;
+    header.log_sequence = log_sequence;
+    std::strncpy(header.hasher, hasher, SnapshotHeader::HASHER_NAME_BYTES - 1);
+    header.table_offset = snapshot_align(sizeof(header));
+    header.table_bytes = table.table_bytes();
+    header.payload_offset = snapshot_align(header.table_offset + header.table_bytes);
+    header.payload_bytes = table.capacity() * sizeof(uint32_t);
+    header.records_offset = snapshot_align(header.payload_offset + header.payload_bytes);
+    header.record_count = values.record_count();
+    header.arena_offset = snapshot_align(header.records_offset + header.record_count * sizeof(ByteSpan));
+    header.arena_bytes = values.arena_bytes();
+    header.live_values = values.size();
+    header.dead_bytes = values.dead_bytes();
+    header.file_bytes = header.arena_offset + header.arena_bytes;
+
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = tmp + ": " + std::strerror(errno);
+        return false;
+    }
+    uint64_t written = 0;
+    bool ok = true;
+    auto write_all = [&](const char* data, size_t bytes) {
+        while (ok && bytes > 0) {
+            ssize_t n = ::write(fd, data, bytes);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            data += n;
+            bytes -= static_cast<size_t>(n);
+            written += static_cast<uint64_t>(n);
+        }
+    };
+    auto pad_to = [&](uint64_t offset) {
+        static const char zeros[BucketTable::CACHE_LINE] = {};
+        write_all(zeros, offset - written);
+    };
+
+    write_all(reinterpret_cast<const char*>(&header), sizeof(header));
+    pad_to(header.table_offset);
+    write_all(reinterpret_cast<const char*>(table.bucket_words()), header.table_bytes);
+    pad_to(header.payload_offset);
+    write_all(reinterpret_cast<const char*>(table.payload_array()), header.payload_bytes);
+    pad_to(header.records_offset);
+    values.for_each_record_block(write_all);
+    pad_to(header.arena_offset);
+    values.for_each_arena_block(write_all);
+
+    if (!ok) error = tmp + ": " + std::strerror(errno);
+    if (ok && ::fsync(fd) != 0) {
+        error = tmp + ": " + std::strerror(errno);
+        ok = false;
+    }
+    ::close(fd);
+    if (ok && std::rename(tmp.c_str(), path.c_str()) != 0) {
+        error = path + ": " + std::strerror(errno);
+        ok = false;
+    }
+    if (!ok) std::remove(tmp.c_str());
+    return ok;
+}
+
+class SnapshotFile {
+public:
+    SnapshotFile() {}
+    SnapshotFile(const SnapshotFile&) = delete;
+    SnapshotFile& operator=(const SnapshotFile&) = delete;
+    ~SnapshotFile() { close(); }
+
+    // Maps and validates a snapshot written for `hasher`
+    bool open(const std::string& path, const char* hasher, std::string& error) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = path + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+            ::close(fd);
+            error = path + ": not a snapshot";
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            size_ = 0;
+            error = path + ": " + std::strerror(errno);
+            return false;
+        }
+        data_ = static_cast<char*>(p);
+        madvise(data_, size_, MADV_RANDOM);
+
+        if (!validate(hasher, error)) {
+            error = path + ": " + error;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (data_) munmap(data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const SnapshotHeader& header() const { return *reinterpret_cast<const SnapshotHeader*>(data_); }
+    uint64_t* bucket_words() { return reinterpret_cast<uint64_t*>(data_ + header().table_offset); }
+    uint32_t* payloads() { return reinterpret_cast<uint32_t*>(data_ + header().payload_offset); }
+    ByteSpan* records() { return reinterpret_cast<ByteSpan*>(data_ + header().records_offset); }
+    char* arena() { return data_ + header().arena_offset; }
+    size_t file_bytes() const { return size_; }
+
+private:
+    bool validate(const char* hasher, std::string& error) const {
+        const SnapshotHeader& h = header();
+        if (std::memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0) {
+            error = "not a snapshot";
+            return false;
+        }
+        if (h.version != SnapshotHeader::VERSION || h.byte_order != SnapshotHeader::BYTE_ORDER_MARK) {
+            error = "unsupported snapshot version or byte order";
+            return false;
+        }
+        if (std::strncmp(h.hasher, hasher, SnapshotHeader::HASHER_NAME_BYTES) != 0) {
+            error = std::string("snapshot was built with hasher ") +
+                    std::string(h.hasher, strnlen(h.hasher, SnapshotHeader::HASHER_NAME_BYTES)) + ", not " + hasher;
+            return false;
+        }
+        if (h.bucket_bits >= 32 || h.slots_per_bucket == 0 || h.tag_bits != h.fingerprint_bits + 1 ||
+            h.block_bits >= 32) {
+            error = "bad geometry";
+            return false;
+        }
+        // The table must agree with what BucketTable would allocate
+        BucketTable expected(nullptr, size_t(1) << h.bucket_bits, h.slots_per_bucket, h.tag_bits);
+        uint64_t slots = (uint64_t(1) << h.bucket_bits) * h.slots_per_bucket;
+        bool fits = h.words_per_bucket == expected.words_per_bucket() && h.table_bytes == expected.memory_bytes() &&
+                    h.payload_bytes == slots * sizeof(uint32_t) && h.table_offset % BucketTable::CACHE_LINE == 0 &&
+                    h.table_offset >= sizeof(SnapshotHeader) && h.payload_offset >= h.table_offset + h.table_bytes &&
+                    h.records_offset >= h.payload_offset + h.payload_bytes &&
+                    h.arena_offset >= h.records_offset + h.record_count * sizeof(ByteSpan) &&
+                    h.file_bytes == h.arena_offset + h.arena_bytes && h.file_bytes == size_ &&
+                    h.record_count <= ValueSlab::NO_INDEX && h.arena_bytes <= ValueSlab::MAX_ARENA_BYTES;
+        if (!fits) {
+            error = "truncated or inconsistent snapshot";
+            return false;
+        }
+        return true;
+    }
+
+    char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,714 @@
+#ifndef PCF_TABLE_H
+#define PCF_TABLE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "blocked_bloom.h"
+#include "bucket_table.h"
+#include "cuckoo_insert.h"
+
+//-----------------------------------------------------------------------------
+// Perfect cuckoo filter core shared by the UTXOManager variants.
+//
+// Works on the 32-bit key hash h: the low bucket_bits of h pick the primary
+// bucket, the next fingerprint_bits are the fingerprint, and the alternate
+// bucket is primary ^ (fingerprint * 0xCC9E2D51 & bucket_mask). A stored
+// (bucket, fingerprint, selector) therefore recovers those bits of h
+// exactly. An optional payload is kept per slot beside the packed tags;
+// Payload = void stores tags only.
+//
+// Growth mode. When the load factor reaches max_load the table doubles its
+// bucket count by taking one bit from the fingerprint: the new primary
+// bucket is the old one plus fingerprint bit 0 on top, the new fingerprint
+// is the old one shifted right by one. bucket_bits + fingerprint_bits stays
+// constant, so the perfect-hashing property is kept. Migration is
+// incremental: every insert/erase moves buckets_per_step old buckets into
+// the new table, and lookups probe both tables until the old one drains.
+//
+// Blocked layout. set_block_bits(k) confines the alternate bucket to the
+// aligned block of 2^k buckets holding the primary: the XOR offset keeps
+// only its low k bits, so it is still an involution and the stored tag
+// still recovers h. With k = BucketTable::line_pair_block_bits() both
+// candidates lie in one cache line or its adjacent-line pair, so a
+// negative lookup costs one random miss instead of two. Fewer alternate
+// choices balance load worse: a block can fill while others have room,
+// so inserts fail (or growth starts) at a lower load factor, and the
+// false positive rate at a given load is unchanged. The setting is kept
+// across growth and in snapshots; 0 (the default) spans the whole table.
+//
+// Pre-filter. enable_prefilter() puts a BlockedBloomFilter over the stored
+// hashes in front of every probe, so most absent keys (lookups, and the
+// duplicate check of inserts) are rejected with one cache line instead of
+// two bucket reads. Inserts add to it; erases leave stale bits, and the
+// filter is rebuilt from the table once the erases since the last build
+// reach PREFILTER_REBUILD_FRACTION of the entries, or the entries outgrow
+// what it was sized for.
+//
+// Memory. Tables built with a MemoryPolicy allocate the tag words and
+// payloads of every generation under it (huge pages, NUMA placement,
+// prefaulting; see src/memory_policy.h). Borrowed storage is left as it is
+// until the first growth.
+//
+// insert_parallel() bulk-loads on several threads by partitioning the
+// bucket array into ranges owned by one worker each.
+//
+// The entry count, the number of entries in their alternate bucket and the
+// capacity are running totals kept by every insert, erase, kick and
+// migration step, so count() and load_factor() are O(1). They are relaxed
+// atomics written only by the thread that owns the table, so a monitoring
+// thread may read them at any time.
+//-----------------------------------------------------------------------------
+
+template <typename Payload>
+class PcfTable {
+public:
+    // Stored per slot; a placeholder for tag-only tables
+    using Stored = typename std::conditional<std::is_void<Payload>::value, char, Payload>::type;
+
+    enum InsertResult { INSERTED, DUPLICATE, FULL };
+
+    static constexpr double DEFAULT_MAX_LOAD = 0.90;
+    static const size_t DEFAULT_BUCKETS_PER_STEP = 4;
+    static const uint32_t MIN_FINGERPRINT_BITS = 4;
+    static constexpr double PREFILTER_REBUILD_FRACTION = 0.25;
+
+    PcfTable(uint32_t bucket_bits, size_t slots_per_bucket, uint32_t fingerprint_bits,
+             size_t max_path_length = CuckooInserter::DEFAULT_MAX_PATH_LENGTH)
+        : PcfTable(bucket_bits, slots_per_bucket, fingerprint_bits, MemoryPolicy(), max_path_length) {}
+
+    PcfTable(uint32_t bucket_bits, size_t slots_per_bucket, uint32_t fingerprint_bits, const MemoryPolicy& memory,
+             size_t max_path_length = CuckooInserter::DEFAULT_MAX_PATH_LENGTH)
+        : current_(new Generation(bucket_bits, slots_per_bucket, fingerprint_bits, 0, memory)),
+          capacity_(current_->capacity()), memory_(memory), inserter_(max_path_length) {}
+
+    // Works in place on tag words and payloads laid out as bucket_words()
+    // and payload_array() of a table with this geometry, e.g. a mapped
+    // snapshot holding `entries` entries, `alternate_entries` of them in
+    // their alternate bucket, placed with `block_bits`. Both must outlive
+    // the table (or its first growth, which moves everything into owned
+    // memory).
+    PcfTable(uint32_t bucket_bits, size_t slots_per_bucket, uint32_t fingerprint_bits, uint64_t* bucket_words,
+             Stored* payloads, size_t entries, size_t alternate_entries, uint32_t block_bits,
+             size_t max_path_length = CuckooInserter::DEFAULT_MAX_PATH_LENGTH)
+        : current_(new Generation(bucket_bits, slots_per_bucket, fingerprint_bits, block_bits, bucket_words, payloads)),
+          entries_(entries), alternate_entries_(alternate_entries), capacity_(current_->capacity()),
+          block_bits_(block_bits), inserter_(max_path_length) {
+        current_->alternates = alternate_entries;
+    }
+
+    // Grow instead of failing once the load factor reaches max_load
+    void enable_growth(double max_load = DEFAULT_MAX_LOAD, size_t buckets_per_step = DEFAULT_BUCKETS_PER_STEP) {
+        growth_enabled_ = true;
+        max_load_ = max_load;
+        buckets_per_step_ = buckets_per_step ? buckets_per_step : 1;
+    }
+
+    // Blocked layout (see above) with blocks of 2^block_bits buckets, or 0
+    // for alternates anywhere; only on an empty table
+    void set_block_bits(uint32_t block_bits) {
+        if (count() > 0 || old_) return;
+        block_bits_ = block_bits;
+        current_->set_alt_mask(block_bits);
+    }
+
+    uint32_t block_bits() const { return block_bits_; }
+
+    // Bloom pre-filter (see above) at bits_per_key of the table's capacity,
+    // built from the current entries; 0 removes it
+    void enable_prefilter(double bits_per_key = BlockedBloomFilter::DEFAULT_BITS_PER_KEY) {
+        prefilter_bits_per_key_ = bits_per_key;
+        if (bits_per_key > 0) {
+            rebuild_prefilter();
+        } else {
+            prefilter_.reset();
+        }
+    }
+
+    bool prefiltered() const { return prefilter_ != nullptr; }
+
+    void rebuild_prefilter() {
+        if (prefilter_bits_per_key_ <= 0) return;
+        prefilter_keys_ = std::max(capacity(), count());
+        prefilter_.reset(new BlockedBloomFilter(prefilter_keys_, prefilter_bits_per_key_));
+        for_each_hash([this](uint32_t h) { prefilter_->add(h); });
+        prefilter_stale_ = 0;
+    }
+
+    size_t prefilter_bytes() const { return prefilter_ ? prefilter_->memory_bytes() : 0; }
+
+    // Calls fn(h) for every entry with the bits of its hash the table keeps
+    // (the low bucket_bits + fingerprint_bits, see kept_bits())
+    template <typename Fn>
+    void for_each_hash(Fn fn) const {
+        for_each_hash_in(*current_, fn);
+        if (old_) for_each_hash_in(*old_, fn);
+    }
+    bool growth_enabled() const { return growth_enabled_; }
+    double max_load() const { return max_load_; }
+    size_t buckets_per_step() const { return buckets_per_step_; }
+    bool migrating() const { return old_ != nullptr; }
+
+    // Moves all remaining old buckets now
+    void finish_migration() {
+        while (old_ && migrate_bucket(true)) {}
+    }
+
+    InsertResult insert(uint32_t h, const Stored& payload = Stored()) {
+        if (old_) {
+            migrate_step();
+        } else if (growth_enabled_ && load_factor() >= max_load_) {
+            start_growth();
+        }
+        if (contains(h)) return DUPLICATE;
+
+        int slot = place(*current_, h, Stored(payload));
+        if (slot < 0 && growth_enabled_ && can_grow()) {
+            finish_migration();
+            start_growth();
+            slot = place(*current_, h, Stored(payload));
+        }
+        if (slot < 0) return FULL;
+        entries_.add(1);
+        if (prefilter_) {
+            prefilter_->add(kept_bits(h));
+            if (count() > prefilter_keys_) rebuild_prefilter();
+        }
+        return INSERTED;
+    }
+
+    const Stored* find(uint32_t h) const {
+        if (prefilter_rejects(h)) return nullptr;
+        const Stored* found = find_in(*current_, h);
+        if (!found && old_) found = find_in(*old_, h);
+        return found;
+    }
+
+    Stored* find(uint32_t h) {
+        return const_cast<Stored*>(static_cast<const PcfTable*>(this)->find(h));
+    }
+
+    // find(), also telling whether the entry was in its alternate bucket
+    const Stored* find(uint32_t h, bool& alternate) const {
+        if (prefilter_rejects(h)) return nullptr;
+        const Stored* found = find_in(*current_, h, alternate);
+        if (!found && old_) found = find_in(*old_, h, alternate);
+        return found;
+    }
+
+    bool contains(uint32_t h) const {
+        if (prefilter_rejects(h)) return false;
+        size_t which;
+        if (probe(*current_, h, which) >= 0) return true;
+        return old_ && probe(*old_, h, which) >= 0;
+    }
+
+    // Requests both candidate buckets (and the primary bucket's payloads)
+    // of h, for batches that probe a few keys behind the prefetch
+    void prefetch(uint32_t h) const {
+        if (prefilter_) prefilter_->prefetch(kept_bits(h));
+        prefetch_in(*current_, h);
+        if (old_) prefetch_in(*old_, h);
+    }
+
+    // Primary bucket of h in the current table, for grouping a batch
+    uint32_t primary_bucket(uint32_t h) const { return current_->bucket_of(h); }
+
+    bool erase(uint32_t h) {
+        Stored removed;
+        return erase(h, removed);
+    }
+
+    // Erases and hands back the entry's payload
+    bool erase(uint32_t h, Stored& removed) {
+        if (old_) migrate_step();
+        if (prefilter_rejects(h)) return false;
+        if (erase_in(*current_, h, removed) || (old_ && erase_in(*old_, h, removed))) {
+            entries_.add(-1);
+            if (prefilter_ && ++prefilter_stale_ > PREFILTER_REBUILD_FRACTION * count()) rebuild_prefilter();
+            return true;
+        }
+        return false;
+    }
+
+    size_t count() const { return entries_.get(); }
+    size_t alternate_entries() const { return alternate_entries_.get(); }
+    size_t primary_entries() const { return count() - alternate_entries(); }
+
+    // Bucket-by-bucket entry count, to check the running total against
+    size_t recount() const {
+        size_t total = count_in(*current_);
+        if (old_) total += count_in(*old_);
+        return total;
+    }
+
+    // Primary / alternate entries and empty buckets, over both tables
+    void tag_counts(size_t& primary, size_t& secondary, size_t& empty_buckets) const {
+        primary = secondary = empty_buckets = 0;
+        tag_counts_in(*current_, primary, secondary, empty_buckets);
+        if (old_) tag_counts_in(*old_, primary, secondary, empty_buckets);
+    }
+
+    double load_factor() const { return static_cast<double>(count()) / capacity(); }
+    size_t capacity() const { return capacity_.get(); }
+    size_t bucket_count() const { return current_->table.size(); }
+    size_t slots_per_bucket() const { return current_->table.slots_per_bucket(); }
+    uint32_t bucket_bits() const { return current_->bucket_bits; }
+    uint32_t fingerprint_bits() const { return current_->fingerprint_bits; }
+    uint32_t tag_bits() const { return current_->table.tag_bits(); }
+    size_t words_per_bucket() const { return current_->table.words_per_bucket(); }
+
+    // Raw storage of the current table, for snapshots; valid while not
+    // migrating() (old buckets live elsewhere)
+    const uint64_t* bucket_words() const { return current_->table.data(); }
+    const Stored* payload_array() const { return current_->payloads; }
+
+    // Packed tag storage only
+    size_t table_bytes() const {
+        return current_->table.memory_bytes() + (old_ ? old_->table.memory_bytes() : 0);
+    }
+
+    // Tags plus per-slot payload arrays
+    size_t memory_bytes() const {
+        size_t bytes = current_->table.memory_bytes() + current_->payload_bytes() + prefilter_bytes();
+        if (old_) bytes += old_->table.memory_bytes() + old_->payload_bytes();
+        return bytes;
+    }
+
+    // Grows ahead of inserting `n` more entries, so a bulk load does not
+    // migrate as it goes (growth mode only)
+    void reserve(size_t n) {
+        if (!growth_enabled_) return;
+        finish_migration();
+        while (!old_ && static_cast<double>(count() + n) / capacity() >= max_load_ && can_grow()) {
+            start_growth();
+            finish_migration();
+        }
+    }
+
+    // Inserts n entries on up to `threads` threads and sets results[i] to
+    // what insert() would return when inserting them in order.
+    //
+    // The bucket array is split into a power-of-two number of contiguous
+    // partitions by the top bucket bits; each item belongs to the partition
+    // of its primary bucket, and its worker owns that range exclusively:
+    // duplicate checks, kicks and payload moves stay inside it. An item
+    // whose alternate bucket or eviction path lies in another partition
+    // is handed off and inserted serially once the workers have joined.
+    void insert_parallel(const uint32_t* hashes, const Stored* payloads, size_t n, size_t threads,
+                         InsertResult* results) {
+        reserve(n);
+        finish_migration();
+        if (threads < 1) threads = 1;
+
+        // Keys already in the table (read-only pass, before any writer starts)
+        std::fill(results, results + n, FULL);
+        if (count() > 0) {
+            parallel_for(threads, n, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    if (contains(hashes[i])) results[i] = DUPLICATE;
+                }
+            });
+        }
+
+        uint32_t part_bits = 0;
+        while ((size_t(1) << part_bits) < 4 * threads && part_bits < current_->bucket_bits) part_bits++;
+        size_t parts = size_t(1) << part_bits;
+        uint32_t shift = current_->bucket_bits - part_bits;
+
+        // Stable counting sort of item indices by partition
+        std::vector<size_t> offsets(parts + 1, 0), items(n);
+        for (size_t i = 0; i < n; i++) offsets[(current_->bucket_of(hashes[i]) >> shift) + 1]++;
+        for (size_t p = 0; p < parts; p++) offsets[p + 1] += offsets[p];
+        {
+            std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < n; i++) items[fill[current_->bucket_of(hashes[i]) >> shift]++] = i;
+        }
+
+        std::vector<CuckooInserter> inserters(parts, CuckooInserter(inserter_.max_path_length()));
+        std::vector<std::vector<size_t>> handoffs(parts);
+        std::vector<size_t> inserted(parts, 0);
+        std::vector<ptrdiff_t> alternate_deltas(parts, 0);
+        std::atomic<size_t> next_part(0);
+        auto worker = [&]() {
+            for (size_t p; (p = next_part.fetch_add(1)) < parts;) {
+                uint32_t first = static_cast<uint32_t>(p << shift);
+                uint32_t last = static_cast<uint32_t>((p + 1) << shift);
+                insert_partition(hashes, payloads, items.data() + offsets[p], offsets[p + 1] - offsets[p], first,
+                                 last, inserters[p], results, handoffs[p], inserted[p], alternate_deltas[p]);
+            }
+        };
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads && t < parts; t++) pool.emplace_back(worker);
+        worker();
+        for (auto& thread : pool) thread.join();
+
+        // Before the serial pass, whose duplicate checks must see these
+        if (prefilter_) {
+            for (size_t i = 0; i < n; i++) {
+                if (results[i] == INSERTED) prefilter_->add(kept_bits(hashes[i]));
+            }
+        }
+
+        std::vector<size_t> handoff;
+        for (size_t p = 0; p < parts; p++) {
+            entries_.add(static_cast<ptrdiff_t>(inserted[p]));
+            add_alternates(*current_, alternate_deltas[p]);
+            // Items that found no path inside their range are not failures:
+            // the serial pass below records how they end up
+            KickHistogram kicks = inserters[p].histogram();
+            kicks.failures = 0;
+            inserter_.merge_histogram(kicks);
+            handoff.insert(handoff.end(), handoffs[p].begin(), handoffs[p].end());
+        }
+        std::sort(handoff.begin(), handoff.end());
+        for (size_t i : handoff) results[i] = insert(hashes[i], payloads[i]);
+    }
+
+    const KickHistogram& kick_histogram() const { return inserter_.histogram(); }
+    size_t max_path_length() const { return inserter_.max_path_length(); }
+
+private:
+    struct Generation {
+        BucketTable table;
+        std::vector<Stored, PolicyAllocator<Stored>> owned_payloads;
+        Stored* payloads; // indexed by table.slot_index(); null for tag-only tables
+        uint32_t bucket_bits;
+        uint32_t fingerprint_bits;
+        uint32_t bucket_mask;
+        uint32_t fingerprint_mask;
+        uint32_t alt_mask;     // bits of the alternate bucket offset: the block, or the whole table
+        size_t alternates = 0; // entries whose tag has the alternate selector
+
+        Generation(uint32_t bbits, size_t slots, uint32_t fbits, uint32_t block_bits, const MemoryPolicy& memory)
+            : table(size_t(1) << bbits, slots, fbits + 1, memory), owned_payloads(PolicyAllocator<Stored>(memory)),
+              bucket_bits(bbits), fingerprint_bits(fbits),
+              bucket_mask(static_cast<uint32_t>((uint64_t(1) << bbits) - 1)),
+              fingerprint_mask(static_cast<uint32_t>((uint64_t(1) << fbits) - 1)) {
+            set_alt_mask(block_bits);
+            if (!std::is_void<Payload>::value) owned_payloads.resize(table.size() * slots);
+            payloads = owned_payloads.empty() ? nullptr : owned_payloads.data();
+        }
+
+        // Over borrowed tag words and payloads (see PcfTable's borrowing constructor)
+        Generation(uint32_t bbits, size_t slots, uint32_t fbits, uint32_t block_bits, uint64_t* words,
+                   Stored* borrowed)
+            : table(words, size_t(1) << bbits, slots, fbits + 1), payloads(borrowed), bucket_bits(bbits),
+              fingerprint_bits(fbits), bucket_mask(static_cast<uint32_t>((uint64_t(1) << bbits) - 1)),
+              fingerprint_mask(static_cast<uint32_t>((uint64_t(1) << fbits) - 1)) {
+            set_alt_mask(block_bits);
+        }
+
+        void set_alt_mask(uint32_t block_bits) {
+            alt_mask = block_bits > 0 && block_bits < bucket_bits ? (1u << block_bits) - 1 : bucket_mask;
+        }
+
+        size_t capacity() const { return table.size() * table.slots_per_bucket(); }
+        size_t payload_bytes() const { return payloads ? table.size() * table.slots_per_bucket() * sizeof(Stored) : 0; }
+
+        uint32_t bucket_of(uint32_t h) const { return h & bucket_mask; }
+        uint32_t fingerprint_of(uint32_t h) const {
+            return bucket_bits >= 32 ? 0 : (h >> bucket_bits) & fingerprint_mask;
+        }
+        uint32_t alt_bucket(uint32_t bucket, uint32_t fingerprint) const {
+            return bucket ^ ((fingerprint * 0xCC9E2D51) & alt_mask);
+        }
+    };
+
+    int probe(const Generation& gen, uint32_t h, size_t& which) const {
+        uint32_t bucket = gen.bucket_of(h);
+        uint32_t fingerprint = gen.fingerprint_of(h);
+        return gen.table.find2(bucket, BucketTable::make_tag(fingerprint, false),
+                               gen.alt_bucket(bucket, fingerprint), BucketTable::make_tag(fingerprint, true), which);
+    }
+
+    void prefetch_in(const Generation& gen, uint32_t h) const {
+        uint32_t bucket = gen.bucket_of(h);
+        gen.table.prefetch(bucket);
+        gen.table.prefetch(gen.alt_bucket(bucket, gen.fingerprint_of(h)));
+        if (gen.payloads) __builtin_prefetch(&gen.payloads[gen.table.slot_index(bucket, 0)]);
+    }
+
+    const Stored* find_in(const Generation& gen, uint32_t h) const {
+        bool alternate;
+        return find_in(gen, h, alternate);
+    }
+
+    const Stored* find_in(const Generation& gen, uint32_t h, bool& alternate) const {
+        size_t which;
+        int slot = probe(gen, h, which);
+        if (slot < 0) return nullptr;
+        alternate = which != gen.bucket_of(h);
+        if (std::is_void<Payload>::value) return &placeholder_;
+        return &gen.payloads[gen.table.slot_index(which, slot)];
+    }
+
+    // Inserts without a duplicate check; -1 if no eviction path was found
+    int place(Generation& gen, uint32_t h, Stored&& payload) {
+        ptrdiff_t alternate_delta = 0;
+        int slot = place(gen, h, std::move(payload), inserter_, [](uint32_t) { return true; }, alternate_delta);
+        add_alternates(gen, alternate_delta);
+        return slot;
+    }
+
+    // Inserts using `inserter`, touching only buckets where allowed(bucket).
+    // Adds the change in alternate-bucket entries (the new one and every
+    // kicked entry, whose selector flips) to alternate_delta.
+    template <typename Allowed>
+    int place(Generation& gen, uint32_t h, Stored&& payload, CuckooInserter& inserter, Allowed allowed,
+              ptrdiff_t& alternate_delta) {
+        uint32_t bucket = gen.bucket_of(h);
+        uint32_t fingerprint = gen.fingerprint_of(h);
+        uint32_t placed;
+        int slot = inserter.insert(
+            gen.table, bucket, gen.alt_bucket(bucket, fingerprint), fingerprint,
+            [&gen](uint32_t b, uint32_t fp) { return gen.alt_bucket(b, fp); },
+            [&gen, &alternate_delta](uint32_t fb, uint32_t fs, uint32_t tb, uint32_t ts) {
+                alternate_delta += BucketTable::tag_selector(gen.table.tag(tb, ts)) ? 1 : -1;
+                if (std::is_void<Payload>::value) return;
+                gen.payloads[gen.table.slot_index(tb, ts)] = std::move(gen.payloads[gen.table.slot_index(fb, fs)]);
+            },
+            allowed, placed);
+        if (slot < 0) return slot;
+        if (BucketTable::tag_selector(gen.table.tag(placed, slot))) alternate_delta++;
+        if (!std::is_void<Payload>::value) gen.payloads[gen.table.slot_index(placed, slot)] = std::move(payload);
+        return slot;
+    }
+
+    // One worker of insert_parallel(): inserts the items of partition `part`
+    // (bucket range [first, last)) in order. Items whose only free path
+    // leaves the range, and later items with the same hash, go to handoff.
+    void insert_partition(const uint32_t* hashes, const Stored* payloads, const size_t* items, size_t num_items,
+                          uint32_t first, uint32_t last, CuckooInserter& inserter, InsertResult* results,
+                          std::vector<size_t>& handoff, size_t& inserted, ptrdiff_t& alternate_delta) {
+        Generation& gen = *current_;
+        auto allowed = [first, last](uint32_t b) { return b >= first && b < last; };
+        std::unordered_set<uint32_t> handed_off;
+        inserted = 0;
+        for (size_t n = 0; n < num_items; n++) {
+            size_t i = items[n];
+            if (results[i] == DUPLICATE) continue;
+            uint32_t h = hashes[i];
+            if (!handed_off.empty() && handed_off.count(h)) {
+                handoff.push_back(i);
+                continue;
+            }
+            uint32_t bucket = gen.bucket_of(h);
+            uint32_t fingerprint = gen.fingerprint_of(h);
+            uint32_t alt = gen.alt_bucket(bucket, fingerprint);
+            if (gen.table.find(bucket, BucketTable::make_tag(fingerprint, false)) >= 0 ||
+                (allowed(alt) && gen.table.find(alt, BucketTable::make_tag(fingerprint, true)) >= 0)) {
+                results[i] = DUPLICATE;
+                continue;
+            }
+            if (place(gen, h, Stored(payloads[i]), inserter, allowed, alternate_delta) < 0) {
+                handoff.push_back(i);
+                handed_off.insert(h);
+                continue;
+            }
+            results[i] = INSERTED;
+            inserted++;
+        }
+    }
+
+    // Removes `slot` from `bucket`, moving the payload that fills the hole
+    void erase_slot(Generation& gen, size_t bucket, size_t slot) {
+        if (BucketTable::tag_selector(gen.table.tag(bucket, slot))) add_alternates(gen, -1);
+        size_t moved = gen.table.erase(bucket, slot);
+        if (std::is_void<Payload>::value) return;
+        gen.payloads[gen.table.slot_index(bucket, slot)] = std::move(gen.payloads[gen.table.slot_index(bucket, moved)]);
+        gen.payloads[gen.table.slot_index(bucket, moved)] = Stored();
+    }
+
+    bool erase_in(Generation& gen, uint32_t h, Stored& removed) {
+        size_t which;
+        int slot = probe(gen, h, which);
+        if (slot < 0) return false;
+        if (!std::is_void<Payload>::value) removed = std::move(gen.payloads[gen.table.slot_index(which, slot)]);
+        erase_slot(gen, which, slot);
+        return true;
+    }
+
+    bool can_grow() const {
+        return current_->fingerprint_bits > MIN_FINGERPRINT_BITS && current_->bucket_bits < 31;
+    }
+
+    void start_growth() {
+        if (old_ || !can_grow()) return;
+        const Generation& gen = *current_;
+        old_ = std::move(current_);
+        current_.reset(new Generation(gen.bucket_bits + 1, gen.table.slots_per_bucket(), gen.fingerprint_bits - 1,
+                                      block_bits_, memory_));
+        capacity_ = current_->capacity();
+        migrate_cursor_ = 0;
+    }
+
+    void migrate_step() {
+        for (size_t n = 0; n < buckets_per_step_ && old_; n++) {
+            if (!migrate_bucket(false)) break;
+        }
+    }
+
+    // Moves every entry of the next old bucket into the new table. An entry
+    // that finds no eviction path stays put (lookups still see it) and the
+    // move is retried on a later step, or forced by finish_migration().
+    bool migrate_bucket(bool force) {
+        Generation& old = *old_;
+        uint32_t b = migrate_cursor_;
+        while (old.table.count(b) > 0) {
+            size_t last = old.table.count(b) - 1;
+            uint32_t tag = old.table.tag(b, last);
+            uint32_t fingerprint = BucketTable::tag_fingerprint(tag);
+            uint32_t primary = BucketTable::tag_selector(tag) ? old.alt_bucket(b, fingerprint) : b;
+            uint32_t h = primary | (old.bucket_bits >= 32 ? 0 : fingerprint << old.bucket_bits);
+            size_t index = old.table.slot_index(b, last);
+            Stored payload = std::is_void<Payload>::value ? Stored() : std::move(old.payloads[index]);
+            if (place(*current_, h, std::move(payload)) < 0) {
+                if (!std::is_void<Payload>::value) old.payloads[index] = std::move(payload);
+                if (!force) return false;
+                // The new table is saturated: grow it again before retrying
+                return finish_forced_growth();
+            }
+            erase_slot(old, b, last);
+        }
+        if (++migrate_cursor_ == old.table.size()) old_.reset();
+        return true;
+    }
+
+    // Last resort when a forced migration cannot place an entry: copy the
+    // remaining old entries and the new table into a fresh table, one
+    // bucket bit larger on every attempt that still leaves an entry out.
+    // False if the fingerprint runs out first; both tables are then kept
+    // as they are, and lookups still see every entry.
+    bool finish_forced_growth() {
+        uint32_t bucket_bits = current_->bucket_bits;
+        uint32_t fingerprint_bits = current_->fingerprint_bits;
+        while (fingerprint_bits > MIN_FINGERPRINT_BITS && bucket_bits < 31) {
+            std::unique_ptr<Generation> next(new Generation(++bucket_bits, current_->table.slots_per_bucket(),
+                                                            --fingerprint_bits, block_bits_, memory_));
+            if (!drain_into(*next, *current_) || !drain_into(*next, *old_)) {
+                alternate_entries_.add(-static_cast<ptrdiff_t>(next->alternates));
+                continue;
+            }
+            // Both are dropped without erasing their entries one by one
+            alternate_entries_.add(-static_cast<ptrdiff_t>(current_->alternates + old_->alternates));
+            current_ = std::move(next);
+            old_.reset();
+            capacity_ = current_->capacity();
+            return true;
+        }
+        return false;
+    }
+
+    template <typename Fn>
+    static void for_each_hash_in(const Generation& gen, Fn& fn) {
+        for (uint32_t b = 0; b < gen.table.size(); b++) {
+            for (size_t i = 0; i < gen.table.count(b); i++) {
+                uint32_t tag = gen.table.tag(b, i);
+                uint32_t fingerprint = BucketTable::tag_fingerprint(tag);
+                uint32_t primary = BucketTable::tag_selector(tag) ? gen.alt_bucket(b, fingerprint) : b;
+                fn(primary | (gen.bucket_bits >= 32 ? 0 : fingerprint << gen.bucket_bits));
+            }
+        }
+    }
+
+    // Copies every entry of `gen` into `into`; false at the first that
+    // finds no place
+    bool drain_into(Generation& into, const Generation& gen) {
+        for (uint32_t b = 0; b < gen.table.size(); b++) {
+            for (size_t i = 0; i < gen.table.count(b); i++) {
+                uint32_t tag = gen.table.tag(b, i);
+                uint32_t fingerprint = BucketTable::tag_fingerprint(tag);
+                uint32_t primary = BucketTable::tag_selector(tag) ? gen.alt_bucket(b, fingerprint) : b;
+                uint32_t h = primary | (gen.bucket_bits >= 32 ? 0 : fingerprint << gen.bucket_bits);
+                Stored payload = std::is_void<Payload>::value ? Stored() : gen.payloads[gen.table.slot_index(b, i)];
+                if (place(into, h, std::move(payload)) < 0) return false;
+            }
+        }
+        return true;
+    }
+
+    // Runs fn(begin, end) over `threads` contiguous slices of [0, n)
+    template <typename Fn>
+    static void parallel_for(size_t threads, size_t n, Fn fn) {
+        std::vector<std::thread> pool;
+        size_t step = (n + threads - 1) / threads;
+        for (size_t begin = step; begin < n; begin += step) {
+            pool.emplace_back(fn, begin, std::min(n, begin + step));
+        }
+        fn(0, std::min(n, step));
+        for (auto& thread : pool) thread.join();
+    }
+
+    // What the table distinguishes of h, and so what the prefilter holds
+    uint32_t kept_bits(uint32_t h) const {
+        uint32_t bits = current_->bucket_bits + current_->fingerprint_bits;
+        return bits >= 32 ? h : h & ((1u << bits) - 1);
+    }
+
+    bool prefilter_rejects(uint32_t h) const { return prefilter_ && !prefilter_->may_contain(kept_bits(h)); }
+
+    void add_alternates(Generation& gen, ptrdiff_t delta) {
+        gen.alternates += delta;
+        alternate_entries_.add(delta);
+    }
+
+    static size_t count_in(const Generation& gen) {
+        size_t total = 0;
+        for (size_t b = 0; b < gen.table.size(); b++) total += gen.table.count(b);
+        return total;
+    }
+
+    static void tag_counts_in(const Generation& gen, size_t& primary, size_t& secondary, size_t& empty_buckets) {
+        for (size_t b = 0; b < gen.table.size(); b++) {
+            size_t n = gen.table.count(b);
+            if (n == 0) empty_buckets++;
+            for (size_t i = 0; i < n; i++) {
+                BucketTable::tag_selector(gen.table.tag(b, i)) ? secondary++ : primary++;
+            }
+        }
+    }
+
+    // A running total: written by the owning thread only, readable from any
+    // (relaxed atomic); copies and moves take the value
+    struct RunningTotal {
+        std::atomic<size_t> value;
+
+        RunningTotal(size_t v = 0) : value(v) {}
+        RunningTotal(const RunningTotal& other) : value(other.get()) {}
+        RunningTotal& operator=(const RunningTotal& other) {
+            value.store(other.get(), std::memory_order_relaxed);
+            return *this;
+        }
+        size_t get() const { return value.load(std::memory_order_relaxed); }
+        void add(ptrdiff_t delta) { value.store(get() + delta, std::memory_order_relaxed); }
+    };
+
+    std::unique_ptr<Generation> current_;
+    std::unique_ptr<Generation> old_; // draining into current_ while growing
+    uint32_t migrate_cursor_ = 0;
+    RunningTotal entries_;
+    RunningTotal alternate_entries_;
+    RunningTotal capacity_;
+    uint32_t block_bits_ = 0;
+    MemoryPolicy memory_;
+    std::unique_ptr<BlockedBloomFilter> prefilter_;
+    double prefilter_bits_per_key_ = 0;
+    size_t prefilter_keys_ = 0;   // entries it was sized for
+    size_t prefilter_stale_ = 0;  // erases since it was built
+    bool growth_enabled_ = false;
+    double max_load_ = DEFAULT_MAX_LOAD;
+    size_t buckets_per_step_ = DEFAULT_BUCKETS_PER_STEP;
+    CuckooInserter inserter_;
+    Stored placeholder_ = Stored();
+};
+
+#endif
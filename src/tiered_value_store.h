@@ -0,0 +1,336 @@
+#ifndef TIERED_VALUE_STORE_H
+#define TIERED_VALUE_STORE_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+//-----------------------------------------------------------------------------
+// Disk-resident UTXO value store with a block cache.
+//
+// The ValueSlab alternative for when only the filter should stay in RAM: the
+// table still keeps a 32-bit index per slot, and each index names an
+// 8-byte in-RAM record (block, offset, length), but the value bytes live
+// in BLOCK_BYTES blocks of a file. Values are bump-allocated into the
+// tail block, so outputs created together share a block. Space is
+// reclaimed a whole block at a time: each block counts its live bytes,
+// and a block whose values have all been spent becomes a later tail
+// block. Freed spans inside a live block are not reused, since filling
+// them would mean reading old blocks back to write new outputs into them.
+//
+// Blocks are read and written through a fixed cache of cache_blocks
+// frames with CLOCK replacement (a reference bit per frame, cleared by
+// the sweeping hand; the first unreferenced frame is the victim) and
+// write-back of dirty frames on eviction or flush(). Newly created
+// outputs are written into the cached tail block, so the young outputs
+// that most spends consume are normally still in the cache.
+//
+// The store is only ever reached through a table hit: a lookup of a key
+// that is not in the set ends at the filter and never reads the file.
+// Values longer than a block go to whole blocks of their own and are read
+// straight from the file.
+//
+// The records that locate values are in RAM only, so the file is scratch
+// space: open() truncates it and close() removes it.
+//-----------------------------------------------------------------------------
+
+struct DiskSpan {
+    uint32_t block;
+    uint16_t offset;
+    uint16_t length;
+};
+
+class TieredValueStore {
+public:
+    static const uint32_t BLOCK_BYTES = 4096;
+    static const uint32_t MAX_VALUE_BYTES = UINT16_MAX;
+    static const size_t DEFAULT_CACHE_BLOCKS = 1024; // 4 MiB
+    static const uint32_t NO_INDEX = UINT32_MAX;
+
+    struct Stats {
+        uint64_t reads = 0;        // read() calls
+        uint64_t cache_hits = 0;   // of those, served from a cached block
+        uint64_t block_reads = 0;  // blocks read from the file
+        uint64_t block_writes = 0; // blocks written back
+    };
+
+    TieredValueStore() {}
+    TieredValueStore(const TieredValueStore&) = delete;
+    TieredValueStore& operator=(const TieredValueStore&) = delete;
+    ~TieredValueStore() { close(); }
+
+    bool open(const std::string& path, size_t cache_blocks, std::string& error) {
+        close();
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            error = path + ": " + std::strerror(errno);
+            return false;
+        }
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_RANDOM);
+        path_ = path;
+        if (cache_blocks == 0) cache_blocks = 1;
+        frames_.reset(new char[cache_blocks * BLOCK_BYTES]);
+        frame_block_.assign(cache_blocks, NO_BLOCK);
+        referenced_.assign(cache_blocks, 0);
+        dirty_.assign(cache_blocks, 0);
+        frame_of_.clear();
+        frame_of_.reserve(cache_blocks * 2);
+        hand_ = 0;
+        blocks_ = 0;
+        tail_ = NO_BLOCK;
+        tail_used_ = BLOCK_BYTES;
+        file_end_ = 0;
+        failed_ = false;
+        stats_ = Stats();
+        return true;
+    }
+
+    void close() {
+        if (fd_ < 0) return;
+        ::close(fd_);
+        fd_ = -1;
+        std::remove(path_.c_str());
+        frames_.reset();
+        frame_of_.clear();
+        records_.clear();
+        free_records_.clear();
+        block_live_.clear();
+        free_blocks_.clear();
+        live_ = 0;
+    }
+
+    bool is_open() const { return fd_ >= 0; }
+
+    // NO_INDEX if the value is too long or the file cannot be written
+    uint32_t add(std::string_view encoded) {
+        if (encoded.size() > MAX_VALUE_BYTES) return NO_INDEX;
+        DiskSpan span;
+        if (!store(encoded, span)) return NO_INDEX;
+        uint32_t index;
+        if (!free_records_.empty()) {
+            index = free_records_.back();
+            free_records_.pop_back();
+            records_[index] = span;
+        } else {
+            index = static_cast<uint32_t>(records_.size());
+            records_.push_back(span);
+        }
+        live_++;
+        return index;
+    }
+
+    void release(uint32_t index) {
+        DiskSpan& span = records_[index];
+        if (span.length > BLOCK_BYTES) {
+            for (uint32_t b = 0; b < blocks_for(span.length); b++) free_blocks_.push_back(span.block + b);
+        } else if (span.length > 0) {
+            block_live_[span.block] -= span.length;
+            if (block_live_[span.block] == 0 && span.block != tail_) free_blocks_.push_back(span.block);
+        }
+        span = DiskSpan{0, 0, 0};
+        free_records_.push_back(index);
+        live_--;
+    }
+
+    // Copies the value at `index` into `out`; false on a read error
+    bool read(uint32_t index, std::string& out) const {
+        const DiskSpan& span = records_[index];
+        stats_.reads++;
+        if (span.length == 0) {
+            out.clear();
+            return true;
+        }
+        if (span.offset + span.length > BLOCK_BYTES) {
+            out.resize(span.length);
+            return read_file(&out[0], span.length, uint64_t(span.block) * BLOCK_BYTES + span.offset);
+        }
+        bool hit;
+        const char* frame = cached_block(span.block, false, false, hit);
+        if (!frame) return false;
+        if (hit) stats_.cache_hits++;
+        out.assign(frame + span.offset, span.length);
+        return true;
+    }
+
+    // Writes every dirty cached block back to the file
+    bool flush() {
+        for (size_t f = 0; f < frame_block_.size(); f++) {
+            if (dirty_[f] && !write_back(f)) return false;
+        }
+        return true;
+    }
+
+    size_t size() const { return live_; }
+    size_t free_blocks() const { return free_blocks_.size(); }
+    size_t cache_blocks() const { return frame_block_.size(); }
+    uint64_t file_bytes() const { return uint64_t(blocks_) * BLOCK_BYTES; }
+    const Stats& stats() const { return stats_; }
+    void reset_stats() { stats_ = Stats(); }
+    bool failed() const { return failed_; }
+
+    // RAM only: records, free lists and the block cache
+    size_t memory_bytes() const {
+        size_t bytes = records_.capacity() * sizeof(DiskSpan) + free_records_.capacity() * sizeof(uint32_t) +
+                       block_live_.capacity() * sizeof(uint16_t) + free_blocks_.capacity() * sizeof(uint32_t) +
+                       frame_block_.size() * (BLOCK_BYTES + sizeof(uint32_t) + 2) +
+                       frame_of_.bucket_count() * sizeof(void*) + frame_of_.size() * 2 * sizeof(void*);
+        return bytes;
+    }
+
+private:
+    static constexpr uint32_t NO_BLOCK = UINT32_MAX;
+
+    static uint32_t blocks_for(uint32_t bytes) { return (bytes + BLOCK_BYTES - 1) / BLOCK_BYTES; }
+
+    bool store(std::string_view bytes, DiskSpan& span) {
+        span = DiskSpan{0, 0, static_cast<uint16_t>(bytes.size())};
+        if (bytes.empty()) return true;
+        if (span.length > BLOCK_BYTES) {
+            // A run of whole blocks at the end of the file, written straight through
+            span.block = blocks_;
+            blocks_ += blocks_for(span.length);
+            block_live_.resize(blocks_, 0);
+            return write_file(bytes.data(), span.length, uint64_t(span.block) * BLOCK_BYTES);
+        }
+        bool fresh = false;
+        if (tail_used_ + span.length > BLOCK_BYTES) {
+            if (tail_ != NO_BLOCK && block_live_[tail_] == 0) free_blocks_.push_back(tail_);
+            if (!free_blocks_.empty()) {
+                tail_ = free_blocks_.back();
+                free_blocks_.pop_back();
+            } else {
+                tail_ = blocks_++;
+                block_live_.push_back(0);
+            }
+            tail_used_ = 0;
+            fresh = true;
+        }
+        span.block = tail_;
+        span.offset = static_cast<uint16_t>(tail_used_);
+        tail_used_ += span.length;
+        block_live_[tail_] += span.length;
+        bool hit;
+        char* frame = cached_block(span.block, true, fresh, hit);
+        if (!frame) return false;
+        std::memcpy(frame + span.offset, bytes.data(), span.length);
+        return true;
+    }
+
+    // The cached copy of `block`, loading it (and evicting a frame) on a
+    // miss; `dirty` marks the frame for write-back. Blocks past the end
+    // of the file, and `fresh` blocks (whose old contents are all dead),
+    // are not read.
+    char* cached_block(uint32_t block, bool dirty, bool fresh, bool& hit) const {
+        size_t frame;
+        auto it = frame_of_.find(block);
+        hit = it != frame_of_.end();
+        if (hit) {
+            frame = it->second;
+        } else {
+            frame = victim();
+            if (frame_block_[frame] != NO_BLOCK) {
+                if (dirty_[frame] && !write_back(frame)) return nullptr;
+                frame_of_.erase(frame_block_[frame]);
+                frame_block_[frame] = NO_BLOCK;
+            }
+            char* data = frames_.get() + frame * BLOCK_BYTES;
+            uint64_t offset = uint64_t(block) * BLOCK_BYTES;
+            std::memset(data, 0, BLOCK_BYTES);
+            if (!fresh && offset < file_end_) {
+                if (!read_file(data, static_cast<size_t>(std::min<uint64_t>(BLOCK_BYTES, file_end_ - offset)), offset)) {
+                    return nullptr;
+                }
+                stats_.block_reads++;
+            }
+            frame_block_[frame] = block;
+            frame_of_.emplace(block, frame);
+        }
+        referenced_[frame] = 1;
+        if (dirty) dirty_[frame] = 1;
+        return frames_.get() + frame * BLOCK_BYTES;
+    }
+
+    // CLOCK: sweep the hand past referenced frames, clearing their bits
+    size_t victim() const {
+        for (;;) {
+            size_t frame = hand_;
+            hand_ = (hand_ + 1) % frame_block_.size();
+            if (frame_block_[frame] == NO_BLOCK || !referenced_[frame]) return frame;
+            referenced_[frame] = 0;
+        }
+    }
+
+    bool write_back(size_t frame) const {
+        uint64_t offset = uint64_t(frame_block_[frame]) * BLOCK_BYTES;
+        if (!write_file(frames_.get() + frame * BLOCK_BYTES, BLOCK_BYTES, offset)) return false;
+        dirty_[frame] = 0;
+        stats_.block_writes++;
+        return true;
+    }
+
+    bool read_file(char* data, size_t bytes, uint64_t offset) const {
+        while (bytes > 0) {
+            ssize_t n = ::pread(fd_, data, bytes, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                failed_ = true;
+                return false;
+            }
+            data += n;
+            bytes -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    bool write_file(const char* data, size_t bytes, uint64_t offset) const {
+        while (bytes > 0) {
+            ssize_t n = ::pwrite(fd_, data, bytes, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                failed_ = true;
+                return false;
+            }
+            data += n;
+            bytes -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        if (offset > file_end_) file_end_ = offset;
+        return true;
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    std::vector<DiskSpan> records_;
+    std::vector<uint32_t> free_records_;
+    std::vector<uint16_t> block_live_;  // live value bytes per block
+    std::vector<uint32_t> free_blocks_; // blocks with no live values
+    uint32_t blocks_ = 0;               // blocks in the file
+    uint32_t tail_ = NO_BLOCK;          // block receiving new values
+    uint32_t tail_used_ = BLOCK_BYTES;
+    size_t live_ = 0;
+
+    // Block cache; read() is logically const
+    mutable std::unique_ptr<char[]> frames_;
+    mutable std::vector<uint32_t> frame_block_; // block held by each frame
+    mutable std::vector<uint8_t> referenced_;
+    mutable std::vector<uint8_t> dirty_;
+    mutable std::unordered_map<uint32_t, size_t> frame_of_;
+    mutable size_t hand_ = 0;
+    mutable uint64_t file_end_ = 0; // bytes actually written to the file
+    mutable bool failed_ = false;
+    mutable Stats stats_;
+};
+
+#endif
@@ -0,0 +1,337 @@
+#ifndef UTXO_CODEC_H
+#define UTXO_CODEC_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "outpoint.h"
+#include "sha256.h"
+
+//-----------------------------------------------------------------------------
+// Compact UTXO value encoding, after Bitcoin Core's coin serialization.
+//
+//   varint(height * 2 + coinbase)
+//   varint(compress_amount(amount))
+//   script: type byte + 20/32-byte hash for the standard templates
+//           (P2PKH, P2SH, P2WPKH, P2WSH), otherwise
+//           varint(NUM_SPECIAL_SCRIPTS + 2 * length + is_text) + bytes
+//
+// Scripts arrive as hex text; anything that is not valid hex is kept
+// verbatim as text. The address is not stored: it is derived from the
+// script (Base58Check for P2PKH/P2SH, bech32 for segwit v0) when asked
+// for, and is empty for non-standard scripts. A P2PKH output encodes to
+// about 25 bytes instead of a ~90-byte struct plus two heap strings.
+//
+// Varints are LEB128: seven bits per byte, high bit set on all but the
+// last byte.
+//-----------------------------------------------------------------------------
+
+enum ScriptType : uint8_t {
+    SCRIPT_P2PKH = 0,  // OP_DUP OP_HASH160 <20> OP_EQUALVERIFY OP_CHECKSIG
+    SCRIPT_P2SH = 1,   // OP_HASH160 <20> OP_EQUAL
+    SCRIPT_P2WPKH = 2, // OP_0 <20>
+    SCRIPT_P2WSH = 3,  // OP_0 <32>
+    NUM_SPECIAL_SCRIPTS = 4
+};
+
+inline void write_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+inline uint64_t read_varint(const uint8_t*& p, const uint8_t* end) {
+    uint64_t value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return value;
+}
+
+// Bounds-checked read of one varint: false if it runs past `end` or does not
+// fit 64 bits
+inline bool read_varint_checked(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// Bitcoin Core's amount compression: strips trailing decimal zeros, so round
+// amounts (1 BTC = 100000000 sat) become one- or two-byte varints.
+inline uint64_t compress_amount(uint64_t n) {
+    if (n == 0) return 0;
+    int e = 0;
+    while ((n % 10) == 0 && e < 9) {
+        n /= 10;
+        e++;
+    }
+    if (e < 9) {
+        int d = static_cast<int>(n % 10);
+        n /= 10;
+        return 1 + (n * 9 + d - 1) * 10 + e;
+    }
+    return 1 + (n - 1) * 10 + 9;
+}
+
+inline uint64_t decompress_amount(uint64_t x) {
+    if (x == 0) return 0;
+    x--;
+    int e = x % 10;
+    x /= 10;
+    uint64_t n = 0;
+    if (e < 9) {
+        int d = (x % 9) + 1;
+        x /= 9;
+        n = x * 10 + d;
+    } else {
+        n = x + 1;
+    }
+    while (e-- > 0) n *= 10;
+    return n;
+}
+
+// Script template of raw script bytes; the hash is at bytes + *hash_offset
+inline int match_script_template(const uint8_t* s, size_t len, size_t& hash_offset) {
+    if (len == 25 && s[0] == 0x76 && s[1] == 0xA9 && s[2] == 0x14 && s[23] == 0x88 && s[24] == 0xAC) {
+        hash_offset = 3;
+        return SCRIPT_P2PKH;
+    }
+    if (len == 23 && s[0] == 0xA9 && s[1] == 0x14 && s[22] == 0x87) {
+        hash_offset = 2;
+        return SCRIPT_P2SH;
+    }
+    if (len == 22 && s[0] == 0x00 && s[1] == 0x14) {
+        hash_offset = 2;
+        return SCRIPT_P2WPKH;
+    }
+    if (len == 34 && s[0] == 0x00 && s[1] == 0x20) {
+        hash_offset = 2;
+        return SCRIPT_P2WSH;
+    }
+    return -1;
+}
+
+inline size_t script_hash_size(int type) { return type == SCRIPT_P2WSH ? 32 : 20; }
+
+// Appends the compact encoding of one value to `out`
+inline void encode_utxo(bool coinbase, uint64_t height, uint64_t amount, std::string_view script, std::string& out) {
+    write_varint(out, height * 2 + (coinbase ? 1 : 0));
+    write_varint(out, compress_amount(amount));
+
+    bool is_hex = script.size() % 2 == 0;
+    for (size_t i = 0; i < script.size() && is_hex; i++) is_hex = hex_digit_value(script[i]) >= 0;
+    if (!is_hex) {
+        write_varint(out, NUM_SPECIAL_SCRIPTS + 2 * script.size() + 1);
+        out.append(script.data(), script.size());
+        return;
+    }
+
+    size_t len = script.size() / 2;
+    uint8_t bytes[64];
+    size_t hash_offset;
+    if (len <= sizeof(bytes) && decode_hex(script.data(), script.size(), bytes)) {
+        int type = match_script_template(bytes, len, hash_offset);
+        if (type >= 0) {
+            out += static_cast<char>(type);
+            out.append(reinterpret_cast<const char*>(bytes + hash_offset), script_hash_size(type));
+            return;
+        }
+    }
+    write_varint(out, NUM_SPECIAL_SCRIPTS + 2 * len);
+    size_t start = out.size();
+    out.resize(start + len);
+    decode_hex(script.data(), script.size(), reinterpret_cast<uint8_t*>(&out[start]));
+}
+
+inline std::string to_hex(const uint8_t* bytes, size_t len) {
+    static const char hex_digits[] = "0123456789abcdef";
+    std::string text;
+    text.reserve(2 * len);
+    for (size_t i = 0; i < len; i++) {
+        text += hex_digits[bytes[i] >> 4];
+        text += hex_digits[bytes[i] & 15];
+    }
+    return text;
+}
+
+// Base58Check(version || payload)
+inline std::string base58check(uint8_t version, const uint8_t* payload, size_t len) {
+    static const char alphabet[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    uint8_t data[64];
+    data[0] = version;
+    std::memcpy(data + 1, payload, len);
+    uint8_t digest[32];
+    sha256(data, len + 1, digest);
+    sha256(digest, sizeof(digest), digest);
+    std::memcpy(data + len + 1, digest, 4);
+    size_t size = len + 5;
+
+    // Repeated division of the big-endian number by 58
+    uint8_t digits[96];
+    size_t num_digits = 0;
+    for (size_t i = 0; i < size; i++) {
+        uint32_t carry = data[i];
+        for (size_t j = 0; j < num_digits; j++) {
+            carry += static_cast<uint32_t>(digits[j]) << 8;
+            digits[j] = carry % 58;
+            carry /= 58;
+        }
+        while (carry) {
+            digits[num_digits++] = carry % 58;
+            carry /= 58;
+        }
+    }
+    std::string text;
+    for (size_t i = 0; i < size && data[i] == 0; i++) text += '1';
+    while (num_digits > 0) text += alphabet[digits[--num_digits]];
+    return text;
+}
+
+// Segwit v0 bech32 address (BIP 173)
+inline std::string bech32_address(const char* hrp, const uint8_t* program, size_t len) {
+    static const char charset[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+    auto polymod_step = [](uint32_t chk, uint8_t value) {
+        static const uint32_t gen[5] = {0x3b6a57b2, 0x26508e6d, 0x1ea119fa, 0x3d4233dd, 0x2a1462b3};
+        uint8_t top = chk >> 25;
+        chk = ((chk & 0x1ffffff) << 5) ^ value;
+        for (int i = 0; i < 5; i++) {
+            if ((top >> i) & 1) chk ^= gen[i];
+        }
+        return chk;
+    };
+
+    uint8_t values[64];
+    size_t num_values = 0;
+    values[num_values++] = 0; // witness version
+    uint32_t acc = 0;
+    int bits = 0;
+    for (size_t i = 0; i < len; i++) {
+        acc = (acc << 8) | program[i];
+        bits += 8;
+        while (bits >= 5) {
+            bits -= 5;
+            values[num_values++] = (acc >> bits) & 31;
+        }
+    }
+    if (bits > 0) values[num_values++] = (acc << (5 - bits)) & 31;
+
+    uint32_t chk = 1;
+    size_t hrp_len = std::strlen(hrp);
+    for (size_t i = 0; i < hrp_len; i++) chk = polymod_step(chk, hrp[i] >> 5);
+    chk = polymod_step(chk, 0);
+    for (size_t i = 0; i < hrp_len; i++) chk = polymod_step(chk, hrp[i] & 31);
+    for (size_t i = 0; i < num_values; i++) chk = polymod_step(chk, values[i]);
+    for (int i = 0; i < 6; i++) chk = polymod_step(chk, 0);
+    chk ^= 1;
+
+    std::string text(hrp);
+    text += '1';
+    for (size_t i = 0; i < num_values; i++) text += charset[values[i]];
+    for (int i = 0; i < 6; i++) text += charset[(chk >> (5 * (5 - i))) & 31];
+    return text;
+}
+
+// True if `encoded` is exactly one value in this encoding: both varints,
+// then a script code followed by the bytes it implies and nothing else.
+// Bytes from outside (the service's ADD) are checked with this before
+// they are stored.
+inline bool valid_utxo_encoding(std::string_view encoded) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(encoded.data());
+    const uint8_t* end = p + encoded.size();
+    uint64_t packed, amount, code;
+    if (!read_varint_checked(p, end, packed) || !read_varint_checked(p, end, amount) || !read_varint_checked(p, end, code)) {
+        return false;
+    }
+    uint64_t remaining = static_cast<uint64_t>(end - p);
+    if (code < NUM_SPECIAL_SCRIPTS) return remaining == script_hash_size(static_cast<int>(code));
+    return (code - NUM_SPECIAL_SCRIPTS) >> 1 == remaining;
+}
+
+// Non-owning view of one encoded value. The height/coinbase and amount
+// varints are decoded up front; script and address are rebuilt on demand,
+// never reading past the end of the view.
+class ValueRef {
+public:
+    ValueRef() : found_(false), coinbase_(false), height_(0), amount_(0), script_(nullptr), end_(nullptr) {}
+
+    explicit ValueRef(std::string_view encoded) : found_(true) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(encoded.data());
+        end_ = p + encoded.size();
+        uint64_t packed = read_varint(p, end_);
+        coinbase_ = packed & 1;
+        height_ = packed >> 1;
+        amount_ = decompress_amount(read_varint(p, end_));
+        script_ = p;
+    }
+
+    explicit operator bool() const { return found_; }
+
+    bool coinbase() const { return coinbase_; }
+    uint64_t height() const { return height_; }
+    uint64_t amount() const { return amount_; }
+
+    // Script type (ScriptType), or -1 for a raw script
+    int script_type() const {
+        const uint8_t* p = script_;
+        uint64_t code = read_varint(p, end_);
+        return code < NUM_SPECIAL_SCRIPTS ? static_cast<int>(code) : -1;
+    }
+
+    // Script as hex text (or the original text if it was not hex)
+    std::string script() const {
+        const uint8_t* p = script_;
+        uint64_t code = read_varint(p, end_);
+        size_t remaining = static_cast<size_t>(end_ - p);
+        if (code < NUM_SPECIAL_SCRIPTS) {
+            static const char* const prefixes[] = {"76a914", "a914", "0014", "0020"};
+            static const char* const suffixes[] = {"88ac", "87", "", ""};
+            return prefixes[code] + to_hex(p, std::min(script_hash_size(static_cast<int>(code)), remaining)) + suffixes[code];
+        }
+        size_t len = static_cast<size_t>(std::min<uint64_t>((code - NUM_SPECIAL_SCRIPTS) >> 1, remaining));
+        if ((code - NUM_SPECIAL_SCRIPTS) & 1) return std::string(reinterpret_cast<const char*>(p), len);
+        return to_hex(p, len);
+    }
+
+    // Mainnet address derived from the script; empty if non-standard
+    std::string address() const {
+        const uint8_t* p = script_;
+        uint64_t code = read_varint(p, end_);
+        if (code < NUM_SPECIAL_SCRIPTS && static_cast<size_t>(end_ - p) < script_hash_size(static_cast<int>(code))) {
+            return std::string(); // truncated
+        }
+        switch (code) {
+        case SCRIPT_P2PKH:
+            return base58check(0x00, p, 20);
+        case SCRIPT_P2SH:
+            return base58check(0x05, p, 20);
+        case SCRIPT_P2WPKH:
+            return bech32_address("bc", p, 20);
+        case SCRIPT_P2WSH:
+            return bech32_address("bc", p, 32);
+        default:
+            return std::string();
+        }
+    }
+
+private:
+    bool found_;
+    bool coinbase_;
+    uint64_t height_;
+    uint64_t amount_;
+    const uint8_t* script_; // first byte of the script encoding
+    const uint8_t* end_;
+};
+
+#endif
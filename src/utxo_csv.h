@@ -0,0 +1,285 @@
+#ifndef UTXO_CSV_H
+#define UTXO_CSV_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//-----------------------------------------------------------------------------
+// Zero-copy UTXO CSV reader.
+//
+// The dump is mmap'ed read-only and walked line by line; fields are
+// string_views into the mapping, so no line or token is ever copied.
+// Rows are "txid:index, coinbase, height, amount, script, address".
+//
+// Splitting follows the rules of the original getline/istringstream
+// parser: a ' or " opens a quoted region that runs to the matching quote,
+// delimiters inside it are literal, and the quotes stay in the token; a
+// trailing empty field is dropped. The delimiter is detected once, on the
+// first data row: the first of tab, comma and semicolon that yields six
+// fields, else runs of whitespace. A first line naming "txid:index" or
+// "coinbase" is taken as a header and skipped.
+//
+// parse_utxo_row() strips surrounding quotes, spaces and a trailing \r
+// from each field and parses the integers with from_chars.
+//
+// For parallel loads, remaining() is cut with split_at_lines() and each
+// chunk gets its own reader through open_view().
+//-----------------------------------------------------------------------------
+
+class MappedFile {
+public:
+    MappedFile() : data_(nullptr), size_(0) {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& filename) {
+        close();
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                size_ = 0;
+                return false;
+            }
+            madvise(p, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(p);
+        }
+        ::close(fd); // the mapping keeps the file alive
+        open_ = true;
+        return true;
+    }
+
+    void close() {
+        if (data_) munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+        open_ = false;
+    }
+
+    bool is_open() const { return open_; }
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+private:
+    const char* data_;
+    size_t size_;
+    bool open_ = false;
+};
+
+struct CsvRow {
+    static const size_t MAX_FIELDS = 16;
+
+    size_t line_num;       // 1-based physical line number
+    std::string_view line; // without the newline
+    std::string_view fields[MAX_FIELDS];
+    size_t num_fields;     // fields found (may exceed MAX_FIELDS; extras are not kept)
+};
+
+// Splits on `delimiter`, or on whitespace runs when delimiter is ' '
+inline size_t split_csv_line(std::string_view line, char delimiter, std::string_view* fields, size_t max_fields) {
+    size_t count = 0;
+    auto emit = [&](size_t begin, size_t end) {
+        if (count < max_fields) fields[count] = line.substr(begin, end - begin);
+        count++;
+    };
+
+    if (delimiter == ' ') {
+        size_t i = 0;
+        while (i < line.size()) {
+            while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) i++;
+            size_t begin = i;
+            while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r') i++;
+            if (i > begin) emit(begin, i);
+        }
+        return count;
+    }
+
+    size_t begin = 0;
+    char quote = '\0';
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (quote) {
+            if (c == quote) quote = '\0';
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+        } else if (c == delimiter) {
+            emit(begin, i);
+            begin = i + 1;
+        }
+    }
+    if (begin < line.size()) emit(begin, line.size());
+    return count;
+}
+
+// First of tab / comma / semicolon giving at least min_fields, else ' '
+inline char detect_csv_delimiter(std::string_view line, size_t min_fields) {
+    std::string_view fields[CsvRow::MAX_FIELDS];
+    for (char delimiter : {'\t', ',', ';'}) {
+        if (split_csv_line(line, delimiter, fields, CsvRow::MAX_FIELDS) >= min_fields) return delimiter;
+    }
+    return ' ';
+}
+
+class UtxoCsvReader {
+public:
+    static const size_t UTXO_FIELDS = 6;
+
+    bool open(const std::string& filename) {
+        if (!file_.open(filename)) return false;
+        text_ = file_.view();
+        pos_ = 0;
+        line_num_ = 0;
+        delimiter_ = '\0';
+        header_skipped_ = false;
+
+        // Consume a header line up front, so header_skipped() is known after open()
+        std::string_view first;
+        if (next_line(first)) {
+            if (first.find("txid:index") != std::string_view::npos || first.find("coinbase") != std::string_view::npos) {
+                header_skipped_ = true;
+            } else {
+                pos_ = 0;
+                line_num_ = 0;
+            }
+        }
+        return true;
+    }
+
+    // Reads `text` (e.g. one chunk of a mapped dump) whose first line is
+    // line lines_before + 1, splitting with a delimiter found earlier
+    void open_view(std::string_view text, size_t lines_before, char delimiter) {
+        file_.close();
+        text_ = text;
+        pos_ = 0;
+        line_num_ = lines_before;
+        delimiter_ = delimiter;
+        header_skipped_ = false;
+    }
+
+    // Detects the delimiter from the first non-empty unread line
+    char peek_delimiter() {
+        for (size_t pos = pos_; delimiter_ == '\0' && pos < text_.size();) {
+            size_t end = text_.find('\n', pos);
+            if (end == std::string_view::npos) end = text_.size();
+            if (end > pos) delimiter_ = detect_csv_delimiter(text_.substr(pos, end - pos), UTXO_FIELDS);
+            pos = end + 1;
+        }
+        return delimiter_;
+    }
+
+    // Unread text, for handing out to parser threads
+    std::string_view remaining() const { return text_.substr(std::min(pos_, text_.size())); }
+
+    // Next line, empty lines included (num_fields == 0)
+    bool next(CsvRow& row) {
+        std::string_view line;
+        if (!next_line(line)) return false;
+        if (delimiter_ == '\0' && !line.empty()) delimiter_ = detect_csv_delimiter(line, UTXO_FIELDS);
+        row.line_num = line_num_;
+        row.line = line;
+        row.num_fields = line.empty() ? 0 : split_csv_line(line, delimiter_, row.fields, CsvRow::MAX_FIELDS);
+        return true;
+    }
+
+    bool header_skipped() const { return header_skipped_; }
+    size_t lines_read() const { return line_num_; }
+    char delimiter() const { return delimiter_; }
+
+private:
+    bool next_line(std::string_view& line) {
+        if (pos_ >= text_.size()) return false;
+        size_t end = text_.find('\n', pos_);
+        if (end == std::string_view::npos) end = text_.size();
+        line = text_.substr(pos_, end - pos_);
+        pos_ = end + 1;
+        line_num_++;
+        return true;
+    }
+
+    MappedFile file_;
+    std::string_view text_;
+    size_t pos_ = 0;
+    size_t line_num_ = 0;
+    char delimiter_ = '\0';
+    bool header_skipped_ = false;
+};
+
+// Splits text into about `count` pieces, each ending after a newline
+inline std::vector<std::string_view> split_at_lines(std::string_view text, size_t count) {
+    std::vector<std::string_view> chunks;
+    size_t target = text.size() / (count ? count : 1) + 1;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = std::min(text.size(), pos + target);
+        if (end < text.size()) {
+            end = text.find('\n', end);
+            end = end == std::string_view::npos ? text.size() : end + 1;
+        }
+        chunks.push_back(text.substr(pos, end - pos));
+        pos = end;
+    }
+    return chunks;
+}
+
+// Physical lines in text (a final line without a newline counts)
+inline size_t count_lines(std::string_view text) {
+    size_t lines = static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+    return lines + (!text.empty() && text.back() != '\n' ? 1 : 0);
+}
+
+// Field without surrounding quotes, spaces and carriage returns
+inline std::string_view trim_csv_field(std::string_view field) {
+    while (!field.empty() && (field.front() == ' ' || field.front() == '\'' || field.front() == '"')) {
+        field.remove_prefix(1);
+    }
+    while (!field.empty() && (field.back() == ' ' || field.back() == '\'' || field.back() == '"' || field.back() == '\r')) {
+        field.remove_suffix(1);
+    }
+    return field;
+}
+
+inline bool parse_csv_uint(std::string_view field, uint64_t& value) {
+    field = trim_csv_field(field);
+    auto parsed = std::from_chars(field.data(), field.data() + field.size(), value);
+    return parsed.ec == std::errc() && parsed.ptr == field.data() + field.size() && !field.empty();
+}
+
+struct UtxoRecord {
+    std::string_view key; // txid:index, as written (parse_outpoint() trims it)
+    bool coinbase;
+    uint64_t height;
+    uint64_t amount;
+    std::string_view script;
+    std::string_view address;
+};
+
+// False if the row has too few columns or a malformed number
+inline bool parse_utxo_row(const CsvRow& row, UtxoRecord& record) {
+    if (row.num_fields < UtxoCsvReader::UTXO_FIELDS) return false;
+    record.key = row.fields[0];
+    record.coinbase = trim_csv_field(row.fields[1]) == "1";
+    if (!parse_csv_uint(row.fields[2], record.height) || !parse_csv_uint(row.fields[3], record.amount)) return false;
+    record.script = trim_csv_field(row.fields[4]);
+    record.address = trim_csv_field(row.fields[5]);
+    return true;
+}
+
+#endif
@@ -0,0 +1,351 @@
+#ifndef UTXO_FILTER_H
+#define UTXO_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "bucket_table.h"
+#include "cuckoo_insert.h"
+#include "hashers.h"
+
+//-----------------------------------------------------------------------------
+// Fixed-geometry perfect cuckoo filter, specialized at compile time.
+//
+// UTXOFilter<BUCKET_BITS, FINGERPRINT_BITS, SLOTS, Hasher, Payload> is the
+// fixed-size case of PcfTable (no growth) with every geometry constant a
+// compile-time constant: bucket and fingerprint masks, the tag width, the
+// per-bucket word count and the SWAR lane masks fold into the probe code,
+// and the slot scan of multi-word buckets is unrolled. The bucket layout
+// is exactly BucketTable's, so memory use is the same. BLOCKED selects
+// PcfTable's blocked layout with BucketTable::line_pair_block_bits():
+// both candidate buckets in one pair of adjacent cache lines.
+//
+// with_utxo_filter() maps a run-time geometry (e.g. from a config sweep)
+// to the matching specialization from UTXO_FILTER_GEOMETRIES and calls a
+// generic callback with its type, so the whole loop using the filter is
+// compiled for that geometry.
+//-----------------------------------------------------------------------------
+
+// BucketTable with SLOTS and TAG_BITS fixed; same tag format and layout
+template <size_t SLOTS, uint32_t TAG_BITS>
+class FixedBucketTable {
+public:
+    static_assert(SLOTS > 0 && SLOTS <= 32, "slot mask is 32 bits");
+    static_assert(TAG_BITS > 1 && TAG_BITS <= 32, "tag is fingerprint + selector");
+
+    static constexpr uint32_t COUNT_BITS = [] {
+        uint32_t bits = 1;
+        while ((size_t(1) << bits) <= SLOTS) bits++;
+        return bits;
+    }();
+    static constexpr size_t WORDS_PER_BUCKET = [] {
+        size_t words = (SLOTS * TAG_BITS + COUNT_BITS + 63) / 64;
+        if (words > BucketTable::WORDS_PER_LINE) return words;
+        size_t rounded = 1;
+        while (rounded < words) rounded <<= 1;
+        return rounded;
+    }();
+    static constexpr uint32_t COUNT_OFFSET = static_cast<uint32_t>(WORDS_PER_BUCKET * 64 - COUNT_BITS);
+    static constexpr uint64_t TAG_MASK = (uint64_t(1) << TAG_BITS) - 1;
+    static constexpr uint64_t LANE_LOW = [] {
+        uint64_t lanes = 0;
+        if (WORDS_PER_BUCKET == 1) {
+            for (size_t i = 0; i < SLOTS; i++) lanes |= uint64_t(1) << (i * TAG_BITS);
+        }
+        return lanes;
+    }();
+    static constexpr uint64_t LANE_HIGH = LANE_LOW << (TAG_BITS - 1);
+
+    explicit FixedBucketTable(size_t num_buckets) : num_buckets_(num_buckets) {
+        data_ = static_cast<uint64_t*>(::operator new(memory_bytes(), std::align_val_t(BucketTable::CACHE_LINE)));
+        std::memset(data_, 0, memory_bytes());
+    }
+
+    FixedBucketTable(const FixedBucketTable&) = delete;
+    FixedBucketTable& operator=(const FixedBucketTable&) = delete;
+    ~FixedBucketTable() { ::operator delete(data_, std::align_val_t(BucketTable::CACHE_LINE)); }
+
+    size_t size() const { return num_buckets_; }
+    static constexpr size_t slots_per_bucket() { return SLOTS; }
+    static constexpr uint32_t tag_bits() { return TAG_BITS; }
+    static constexpr size_t words_per_bucket() { return WORDS_PER_BUCKET; }
+    size_t memory_bytes() const { return num_buckets_ * WORDS_PER_BUCKET * sizeof(uint64_t); }
+    static size_t slot_index(size_t b, size_t slot) { return b * SLOTS + slot; }
+
+    size_t count(size_t b) const { return bucket(b)[WORDS_PER_BUCKET - 1] >> (COUNT_OFFSET % 64); }
+    bool full(size_t b) const { return count(b) == SLOTS; }
+    void prefetch(size_t b) const { __builtin_prefetch(bucket(b)); }
+
+    uint32_t tag(size_t b, size_t slot) const {
+        return static_cast<uint32_t>(get_bits<TAG_BITS>(bucket(b), slot * TAG_BITS));
+    }
+    void set_tag(size_t b, size_t slot, uint32_t tag) { set_bits<TAG_BITS>(bucket(b), slot * TAG_BITS, tag & TAG_MASK); }
+
+    // Bitmask of the occupied slots in bucket b that hold `tag`
+    uint32_t match_mask(size_t b, uint32_t tag) const {
+        const uint64_t* w = bucket(b);
+        if constexpr (WORDS_PER_BUCKET == 1) {
+            uint64_t lanes = swar_match(w[0], tag);
+            uint32_t mask = 0;
+            while (lanes) {
+                mask |= 1u << (__builtin_ctzll(lanes) / TAG_BITS);
+                lanes &= lanes - 1;
+            }
+            return mask;
+        } else {
+            uint32_t occupied = static_cast<uint32_t>((uint64_t(1) << count(b)) - 1);
+            return match_slots(w, tag, std::make_index_sequence<SLOTS>()) & occupied;
+        }
+    }
+
+    int find(size_t b, uint32_t tag) const {
+        uint32_t mask = match_mask(b, tag);
+        return mask ? __builtin_ctz(mask) : -1;
+    }
+
+    // Both candidate buckets; the slot (b1 preferred) and `which`, or -1
+    int find2(size_t b1, uint32_t tag1, size_t b2, uint32_t tag2, size_t& which) const {
+        if constexpr (WORDS_PER_BUCKET == 1) {
+            uint64_t m1 = swar_match(bucket(b1)[0], tag1);
+            uint64_t m2 = swar_match(bucket(b2)[0], tag2);
+            which = m1 ? b1 : b2;
+            uint64_t m = m1 ? m1 : m2;
+            return m ? static_cast<int>(__builtin_ctzll(m) / TAG_BITS) : -1;
+        } else {
+            int slot = find(b1, tag1);
+            which = b1;
+            if (slot < 0) {
+                slot = find(b2, tag2);
+                which = b2;
+            }
+            return slot;
+        }
+    }
+
+    int insert(size_t b, uint32_t tag) {
+        uint64_t* w = bucket(b);
+        size_t n = count(b);
+        if (n == SLOTS) return -1;
+        set_bits<TAG_BITS>(w, n * TAG_BITS, tag & TAG_MASK);
+        set_bits<COUNT_BITS>(w, COUNT_OFFSET, n + 1);
+        return static_cast<int>(n);
+    }
+
+    // As BucketTable::erase(): the last tag fills the hole; returns its old slot
+    size_t erase(size_t b, size_t slot) {
+        uint64_t* w = bucket(b);
+        size_t last = count(b) - 1;
+        if (slot != last) set_bits<TAG_BITS>(w, slot * TAG_BITS, get_bits<TAG_BITS>(w, last * TAG_BITS));
+        set_bits<TAG_BITS>(w, last * TAG_BITS, 0);
+        set_bits<COUNT_BITS>(w, COUNT_OFFSET, last);
+        return last;
+    }
+
+private:
+    template <uint32_t WIDTH>
+    static uint64_t get_bits(const uint64_t* w, size_t offset) {
+        size_t word = offset >> 6, shift = offset & 63;
+        uint64_t value = w[word] >> shift;
+        if (shift + WIDTH > 64) value |= w[word + 1] << (64 - shift);
+        return value & ((uint64_t(1) << WIDTH) - 1);
+    }
+
+    template <uint32_t WIDTH>
+    static void set_bits(uint64_t* w, size_t offset, uint64_t value) {
+        const uint64_t mask = (uint64_t(1) << WIDTH) - 1;
+        size_t word = offset >> 6, shift = offset & 63;
+        w[word] = (w[word] & ~(mask << shift)) | (value << shift);
+        if (shift + WIDTH > 64) {
+            size_t spill = 64 - shift;
+            w[word + 1] = (w[word + 1] & ~(mask >> spill)) | (value >> spill);
+        }
+    }
+
+    template <size_t... I>
+    static uint32_t match_slots(const uint64_t* w, uint32_t tag, std::index_sequence<I...>) {
+        return ((uint32_t(get_bits<TAG_BITS>(w, I * TAG_BITS) == tag) << I) | ...);
+    }
+
+    // See BucketTable::swar_match()
+    static uint64_t swar_match(uint64_t word, uint32_t tag) {
+        const uint64_t low_bits = LANE_HIGH - LANE_LOW;
+        uint64_t x = word ^ (tag * LANE_LOW);
+        uint64_t y = ((x & low_bits) + low_bits) | x | low_bits;
+        size_t n = word >> COUNT_OFFSET;
+        uint64_t occupied = n == SLOTS ? ~uint64_t(0) : (uint64_t(1) << (n * TAG_BITS)) - 1;
+        return ~y & LANE_HIGH & occupied;
+    }
+
+    const uint64_t* bucket(size_t b) const { return data_ + b * WORDS_PER_BUCKET; }
+    uint64_t* bucket(size_t b) { return data_ + b * WORDS_PER_BUCKET; }
+
+    size_t num_buckets_;
+    uint64_t* data_;
+};
+
+template <uint32_t BUCKET_BITS, uint32_t FINGERPRINT_BITS, size_t SLOTS, typename Hasher = Crc32Hasher,
+          typename Payload = uint32_t, bool BLOCKED = false>
+class UTXOFilter {
+public:
+    // As in PcfTable, fingerprint bits past bit 31 of the hash stay zero
+    static_assert(BUCKET_BITS > 0 && BUCKET_BITS < 32 && FINGERPRINT_BITS < 32, "hash is 32 bits");
+
+    using Table = FixedBucketTable<SLOTS, FINGERPRINT_BITS + 1>;
+    enum InsertResult { INSERTED, DUPLICATE, FULL };
+
+    static constexpr size_t NUM_BUCKETS = size_t(1) << BUCKET_BITS;
+    static constexpr uint32_t BUCKET_MASK = static_cast<uint32_t>(NUM_BUCKETS - 1);
+    static constexpr uint32_t FINGERPRINT_MASK = static_cast<uint32_t>((uint64_t(1) << FINGERPRINT_BITS) - 1);
+    static constexpr uint32_t LINE_PAIR_BITS = BucketTable::line_pair_block_bits(Table::WORDS_PER_BUCKET);
+    static constexpr uint32_t BLOCK_BITS = BLOCKED && LINE_PAIR_BITS < BUCKET_BITS ? LINE_PAIR_BITS : BUCKET_BITS;
+    static constexpr uint32_t ALT_MASK = static_cast<uint32_t>((uint64_t(1) << BLOCK_BITS) - 1);
+
+    explicit UTXOFilter(size_t max_path_length = CuckooInserter::DEFAULT_MAX_PATH_LENGTH)
+        : table_(NUM_BUCKETS), payloads_(new Payload[NUM_BUCKETS * SLOTS]()), inserter_(max_path_length) {}
+
+    UTXOFilter(const UTXOFilter&) = delete;
+    UTXOFilter& operator=(const UTXOFilter&) = delete;
+    ~UTXOFilter() { delete[] payloads_; }
+
+    template <typename Key>
+    uint32_t hash(const Key& key) const { return hasher_(&key, sizeof(key)); }
+
+    InsertResult insert(uint32_t h, const Payload& payload = Payload()) {
+        if (contains(h)) return DUPLICATE;
+        uint32_t bucket = bucket_of(h);
+        uint32_t fingerprint = fingerprint_of(h);
+        uint32_t placed;
+        int slot = inserter_.insert(
+            table_, bucket, alt_bucket(bucket, fingerprint), fingerprint,
+            [](uint32_t b, uint32_t fp) { return alt_bucket(b, fp); },
+            [this](uint32_t fb, uint32_t fs, uint32_t tb, uint32_t ts) {
+                payloads_[Table::slot_index(tb, ts)] = std::move(payloads_[Table::slot_index(fb, fs)]);
+            },
+            placed);
+        if (slot < 0) return FULL;
+        payloads_[Table::slot_index(placed, slot)] = payload;
+        entries_++;
+        return INSERTED;
+    }
+
+    const Payload* find(uint32_t h) const {
+        size_t which;
+        int slot = probe(h, which);
+        return slot < 0 ? nullptr : &payloads_[Table::slot_index(which, slot)];
+    }
+
+    bool contains(uint32_t h) const {
+        size_t which;
+        return probe(h, which) >= 0;
+    }
+
+    void prefetch(uint32_t h) const {
+        uint32_t bucket = bucket_of(h);
+        table_.prefetch(bucket);
+        table_.prefetch(alt_bucket(bucket, fingerprint_of(h)));
+    }
+
+    bool erase(uint32_t h, Payload& removed) {
+        size_t which;
+        int slot = probe(h, which);
+        if (slot < 0) return false;
+        removed = std::move(payloads_[Table::slot_index(which, slot)]);
+        size_t moved = table_.erase(which, slot);
+        payloads_[Table::slot_index(which, slot)] = std::move(payloads_[Table::slot_index(which, moved)]);
+        payloads_[Table::slot_index(which, moved)] = Payload();
+        entries_--;
+        return true;
+    }
+
+    size_t count() const { return entries_; }
+    static constexpr size_t capacity() { return NUM_BUCKETS * SLOTS; }
+    double load_factor() const { return static_cast<double>(entries_) / capacity(); }
+    static constexpr size_t bucket_count() { return NUM_BUCKETS; }
+    static constexpr size_t slots_per_bucket() { return SLOTS; }
+    static constexpr uint32_t bucket_bits() { return BUCKET_BITS; }
+    static constexpr uint32_t fingerprint_bits() { return FINGERPRINT_BITS; }
+    static constexpr bool blocked() { return BLOCKED; }
+    size_t table_bytes() const { return table_.memory_bytes(); }
+    size_t memory_bytes() const { return table_.memory_bytes() + capacity() * sizeof(Payload); }
+    const KickHistogram& kick_histogram() const { return inserter_.histogram(); }
+    size_t max_path_length() const { return inserter_.max_path_length(); }
+
+private:
+    static uint32_t bucket_of(uint32_t h) { return h & BUCKET_MASK; }
+    static uint32_t fingerprint_of(uint32_t h) { return (h >> BUCKET_BITS) & FINGERPRINT_MASK; }
+    static uint32_t alt_bucket(uint32_t bucket, uint32_t fingerprint) {
+        return bucket ^ ((fingerprint * 0xCC9E2D51) & ALT_MASK);
+    }
+
+    int probe(uint32_t h, size_t& which) const {
+        uint32_t bucket = bucket_of(h);
+        uint32_t fingerprint = fingerprint_of(h);
+        return table_.find2(bucket, BucketTable::make_tag(fingerprint, false), alt_bucket(bucket, fingerprint),
+                            BucketTable::make_tag(fingerprint, true), which);
+    }
+
+    Hasher hasher_;
+    Table table_;
+    Payload* payloads_;
+    size_t entries_ = 0;
+    CuckooInserter inserter_;
+};
+
+// Geometries with_utxo_filter() can dispatch to: the benchmark sweeps'
+// (bucket bits, fingerprint bits) pairs with 4 and 8 slots per bucket
+template <uint32_t BUCKET_BITS, uint32_t FINGERPRINT_BITS, size_t SLOTS>
+struct UTXOFilterGeometry {};
+
+template <typename... Geometries>
+struct UTXOFilterGeometryList {};
+
+using UTXO_FILTER_GEOMETRIES = UTXOFilterGeometryList<
+    UTXOFilterGeometry<17, 10, 4>, UTXOFilterGeometry<18, 10, 4>, UTXOFilterGeometry<18, 13, 4>,
+    UTXOFilterGeometry<19, 13, 4>, UTXOFilterGeometry<20, 15, 4>, UTXOFilterGeometry<20, 17, 4>,
+    UTXOFilterGeometry<17, 10, 8>, UTXOFilterGeometry<18, 10, 8>, UTXOFilterGeometry<18, 13, 8>,
+    UTXOFilterGeometry<19, 13, 8>, UTXOFilterGeometry<20, 15, 8>, UTXOFilterGeometry<20, 17, 8>>;
+
+// Passed to with_utxo_filter() callbacks; ::type is the filter class
+template <typename Filter>
+struct UTXOFilterType {
+    using type = Filter;
+};
+
+template <typename Hasher, typename Payload, typename Fn>
+bool with_utxo_filter(uint32_t, uint32_t, size_t, bool, Fn&, UTXOFilterGeometryList<>) {
+    return false;
+}
+
+template <typename Hasher, typename Payload, typename Fn, uint32_t B, uint32_t F, size_t S, typename... Rest>
+bool with_utxo_filter(uint32_t bucket_bits, uint32_t fingerprint_bits, size_t slots, bool blocked, Fn& fn,
+                      UTXOFilterGeometryList<UTXOFilterGeometry<B, F, S>, Rest...>) {
+    if (bucket_bits == B && fingerprint_bits == F && slots == S) {
+        if (blocked) {
+            fn(UTXOFilterType<UTXOFilter<B, F, S, Hasher, Payload, true>>());
+        } else {
+            fn(UTXOFilterType<UTXOFilter<B, F, S, Hasher, Payload, false>>());
+        }
+        return true;
+    }
+    return with_utxo_filter<Hasher, Payload>(bucket_bits, fingerprint_bits, slots, blocked, fn,
+                                             UTXOFilterGeometryList<Rest...>());
+}
+
+// Calls fn(UTXOFilterType<UTXOFilter<...>>()) for the specialization with
+// this geometry and layout; false (fn not called) if it is not in
+// UTXO_FILTER_GEOMETRIES
+template <typename Hasher, typename Payload, typename Fn>
+bool with_utxo_filter(uint32_t bucket_bits, uint32_t fingerprint_bits, size_t slots, bool blocked, Fn fn) {
+    return with_utxo_filter<Hasher, Payload>(bucket_bits, fingerprint_bits, slots, blocked, fn,
+                                             UTXO_FILTER_GEOMETRIES());
+}
+
+template <typename Hasher, typename Payload, typename Fn>
+bool with_utxo_filter(uint32_t bucket_bits, uint32_t fingerprint_bits, size_t slots, Fn fn) {
+    return with_utxo_filter<Hasher, Payload>(bucket_bits, fingerprint_bits, slots, false, fn);
+}
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef UTXO_PROTOCOL_H
+#define UTXO_PROTOCOL_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "outpoint.h"
+
+//-----------------------------------------------------------------------------
+// Binary framing of the UTXO lookup service (src/utxo_server.h).
+//
+// Every request and response is a 16-byte header and a body, all fields
+// little-endian:
+//
+//   u32 body_bytes | u8 op | u8 status | u16 reserved | u32 request_id | u32 count
+//
+// Requests carry batches; `count` is the number of entries in the body:
+//   GET    count x OutPoint (32-byte txid, u32 vout)
+//   ADD    count x { OutPoint, u32 length, value in the utxo_codec encoding }
+//   DEL    count x OutPoint
+//   STATS  empty; the response body is the stats snapshot as JSON
+// Responses echo op, request_id and count and have status OK, with one
+// result per entry in request order:
+//   GET    u32 length, then the encoded value; length 0 = not found
+//   ADD    u8 AddResult
+//   DEL    u8 DelResult
+// A request the server cannot parse, including an ADD value that is not
+// exactly one well-formed encoding, gets status BAD_REQUEST and an empty
+// body; a header announcing more than MAX_BODY_BYTES closes the
+// connection. Responses obey the same limit. ADD and DEL answers are
+// smaller than their requests, but a GET answer grows with the values:
+// one whose body would pass MAX_BODY_BYTES is not sent, and the request
+// gets status TOO_LARGE and an empty body instead, to be retried as
+// smaller batches. A GET of a single key always fits: the value came in
+// an ADD body, which has the same MAX_BODY_BYTES limit as a response,
+// and the ADD entry around it is longer than the GET result.
+//
+// Clients may pipeline: send any number of requests without waiting, and
+// match responses, which come back in order, by request_id.
+//
+// Values travel in the compact encoding the value slab stores, so GET
+// results are copied straight out of the arena and ADD stores the bytes
+// as received once valid_utxo_encoding() has checked them; encode_utxo() /
+// ValueRef convert on the client.
+//
+// UtxoClient is a blocking client for tools and benchmarks. It reads
+// responses while it waits to send, so a deep pipeline of large requests
+// cannot deadlock against the server's backpressure.
+//-----------------------------------------------------------------------------
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the wire format is read and written in host byte order"
+#endif
+
+enum class UtxoOp : uint8_t { GET = 1, ADD = 2, DEL = 3, STATS = 4 };
+
+struct FrameHeader {
+    static const size_t SIZE = 16;
+    static const uint32_t MAX_BODY_BYTES = 16u << 20;
+
+    enum Status : uint8_t { OK = 0, BAD_REQUEST = 1, TOO_LARGE = 2 };
+    enum AddResult : uint8_t { ADDED = 0, DUPLICATE = 1, ADD_FAILED = 2 };
+    enum DelResult : uint8_t { REMOVED = 0, NOT_FOUND = 1 };
+
+    uint32_t body_bytes = 0;
+    uint8_t op = 0;
+    uint8_t status = OK;
+    uint16_t reserved = 0;
+    uint32_t request_id = 0;
+    uint32_t count = 0;
+
+    void write(char* out) const {
+        std::memcpy(out, &body_bytes, 4);
+        out[4] = static_cast<char>(op);
+        out[5] = static_cast<char>(status);
+        std::memcpy(out + 6, &reserved, 2);
+        std::memcpy(out + 8, &request_id, 4);
+        std::memcpy(out + 12, &count, 4);
+    }
+
+    static FrameHeader read(const char* in) {
+        FrameHeader header;
+        std::memcpy(&header.body_bytes, in, 4);
+        header.op = static_cast<uint8_t>(in[4]);
+        header.status = static_cast<uint8_t>(in[5]);
+        std::memcpy(&header.reserved, in + 6, 2);
+        std::memcpy(&header.request_id, in + 8, 4);
+        std::memcpy(&header.count, in + 12, 4);
+        return header;
+    }
+
+    // Appends this header with a placeholder body_bytes; returns its
+    // offset, for finish_frame() once the body is written
+    size_t begin_frame(std::string& out) const {
+        size_t offset = out.size();
+        out.resize(offset + SIZE);
+        write(&out[offset]);
+        return offset;
+    }
+
+    static void finish_frame(std::string& out, size_t offset) {
+        uint32_t body = static_cast<uint32_t>(out.size() - offset - SIZE);
+        std::memcpy(&out[offset], &body, 4);
+    }
+};
+
+template <typename T>
+inline void append_pod(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Bounds-checked reader over a request or response body
+class BodyReader {
+public:
+    explicit BodyReader(std::string_view body) : body_(body) {}
+
+    template <typename T>
+    bool read(T& value) {
+        if (body_.size() - pos_ < sizeof(T)) return false;
+        std::memcpy(&value, body_.data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    bool read_bytes(size_t n, std::string_view& bytes) {
+        if (body_.size() - pos_ < n) return false;
+        bytes = body_.substr(pos_, n);
+        pos_ += n;
+        return true;
+    }
+
+    bool done() const { return pos_ == body_.size(); }
+
+private:
+    std::string_view body_;
+    size_t pos_ = 0;
+};
+
+// Request builders
+inline void append_key_request(std::string& out, UtxoOp op, uint32_t request_id, const OutPoint* keys, size_t n) {
+    FrameHeader header;
+    header.op = static_cast<uint8_t>(op);
+    header.request_id = request_id;
+    header.count = static_cast<uint32_t>(n);
+    size_t frame = header.begin_frame(out);
+    out.append(reinterpret_cast<const char*>(keys), n * sizeof(OutPoint));
+    FrameHeader::finish_frame(out, frame);
+}
+
+inline void append_get_request(std::string& out, uint32_t request_id, const OutPoint* keys, size_t n) {
+    append_key_request(out, UtxoOp::GET, request_id, keys, n);
+}
+
+inline void append_del_request(std::string& out, uint32_t request_id, const OutPoint* keys, size_t n) {
+    append_key_request(out, UtxoOp::DEL, request_id, keys, n);
+}
+
+// `encoded[i]` is the utxo_codec encoding of the value for keys[i]
+inline void append_add_request(std::string& out, uint32_t request_id, const OutPoint* keys,
+                               const std::string_view* encoded, size_t n) {
+    FrameHeader header;
+    header.op = static_cast<uint8_t>(UtxoOp::ADD);
+    header.request_id = request_id;
+    header.count = static_cast<uint32_t>(n);
+    size_t frame = header.begin_frame(out);
+    for (size_t i = 0; i < n; i++) {
+        append_pod(out, keys[i]);
+        append_pod(out, static_cast<uint32_t>(encoded[i].size()));
+        out.append(encoded[i].data(), encoded[i].size());
+    }
+    FrameHeader::finish_frame(out, frame);
+}
+
+inline void append_stats_request(std::string& out, uint32_t request_id) {
+    FrameHeader header;
+    header.op = static_cast<uint8_t>(UtxoOp::STATS);
+    header.request_id = request_id;
+    FrameHeader::finish_frame(out, header.begin_frame(out));
+}
+
+class UtxoClient {
+public:
+    UtxoClient() {}
+    UtxoClient(const UtxoClient&) = delete;
+    UtxoClient& operator=(const UtxoClient&) = delete;
+    ~UtxoClient() { close(); }
+
+    bool connect(const std::string& host, uint16_t port, std::string& error) {
+        close();
+        addrinfo hints{}, *found = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        int rc = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found);
+        if (rc != 0) {
+            error = host + ": " + gai_strerror(rc);
+            return false;
+        }
+        for (addrinfo* a = found; a && fd_ < 0; a = a->ai_next) {
+            fd_ = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+            if (fd_ >= 0 && ::connect(fd_, a->ai_addr, a->ai_addrlen) != 0) close();
+        }
+        freeaddrinfo(found);
+        if (fd_ < 0) {
+            error = host + ":" + std::to_string(port) + ": " + std::strerror(errno);
+            return false;
+        }
+        int one = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return true;
+    }
+
+    // Sends every byte of `frames` (any number of requests); responses
+    // arriving meanwhile are kept for receive()
+    bool send(std::string_view frames) {
+        while (!frames.empty()) {
+            pollfd ready{fd_, POLLIN | POLLOUT, 0};
+            if (::poll(&ready, 1, -1) < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            if ((ready.revents & POLLIN) && !read_available()) return false;
+            if (!(ready.revents & (POLLOUT | POLLERR | POLLHUP))) continue;
+            ssize_t n = ::send(fd_, frames.data(), frames.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+            if (n <= 0) return false;
+            frames.remove_prefix(static_cast<size_t>(n));
+        }
+        return true;
+    }
+
+    // The next response; `body` stays valid until the next receive() or send()
+    bool receive(FrameHeader& header, std::string_view& body) {
+        in_.erase(0, consumed_);
+        consumed_ = 0;
+        if (!fill(FrameHeader::SIZE)) return false;
+        header = FrameHeader::read(in_.data());
+        if (header.body_bytes > FrameHeader::MAX_BODY_BYTES || !fill(FrameHeader::SIZE + header.body_bytes)) return false;
+        body = std::string_view(in_).substr(FrameHeader::SIZE, header.body_bytes);
+        consumed_ = FrameHeader::SIZE + header.body_bytes;
+        return true;
+    }
+
+    void close() {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+        in_.clear();
+        consumed_ = 0;
+    }
+
+private:
+    // Appends what the socket holds without blocking; false once the
+    // server has closed or on error
+    bool read_available() {
+        for (;;) {
+            size_t have = in_.size();
+            in_.resize(have + READ_CHUNK);
+            ssize_t n = ::recv(fd_, &in_[have], READ_CHUNK, MSG_DONTWAIT);
+            in_.resize(have + (n > 0 ? static_cast<size_t>(n) : 0));
+            if (n > 0) continue;
+            if (n < 0 && errno == EINTR) continue;
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+
+    bool fill(size_t bytes) {
+        while (in_.size() < bytes) {
+            size_t have = in_.size();
+            in_.resize(have + READ_CHUNK > bytes ? have + READ_CHUNK : bytes);
+            ssize_t n = ::recv(fd_, &in_[have], in_.size() - have, 0);
+            in_.resize(have + (n > 0 ? static_cast<size_t>(n) : 0));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+        }
+        return true;
+    }
+
+    static const size_t READ_CHUNK = 64 << 10;
+
+    int fd_ = -1;
+    std::string in_;
+    size_t consumed_ = 0;
+};
+
+#endif
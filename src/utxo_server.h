@@ -0,0 +1,284 @@
+#ifndef UTXO_SERVER_H
+#define UTXO_SERVER_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "utxo_protocol.h"
+
+//-----------------------------------------------------------------------------
+// Single-threaded epoll server for the framing of src/utxo_protocol.h.
+//
+// One thread owns the manager, as everywhere else, and runs every
+// connection: the handler is never called concurrently, so it can use
+// the single-writer table directly. Sockets are non-blocking. A readable
+// connection is drained into its input buffer, and every complete frame
+// there is handed to
+//
+//     void Handler::handle(const FrameHeader& request, std::string_view body, std::string& out)
+//
+// which appends exactly one response frame to the connection's output
+// buffer. Pipelined requests thus cost a recv() and one send() per wakeup
+// however many frames they hold. Bodies are parsed in place in the input
+// buffer, and both buffers are kept across requests, so a connection in
+// steady state does not allocate.
+//
+// Durability: responses are only sent once
+//
+//     bool Handler::commit()
+//
+// has returned true, called once per wakeup after the frames of every
+// ready connection were handled. A handler that logs its changes makes
+// them durable there, so an acknowledged write survives a crash, and one
+// sync covers every request of the wakeup (group commit). If commit()
+// fails, the connections holding the unsent responses are closed instead.
+//
+// Backpressure: once a connection has MAX_PENDING_OUTPUT bytes unsent,
+// its remaining frames wait and it stops being polled for input until the
+// peer has read enough; it stays polled for output while frames wait, so
+// they are served as soon as the output drains. Handler::idle() is called after every wakeup and
+// at least every TICK_MS, for the owner's periodic work (compaction,
+// stats export). run() returns once `stop` is set, e.g. from a signal
+// handler; epoll_wait() wakes on the signal.
+//-----------------------------------------------------------------------------
+
+template <typename Handler>
+class UtxoServer {
+public:
+    static const int TICK_MS = 100;
+    static const size_t MAX_PENDING_OUTPUT = 4 << 20;
+
+    UtxoServer() {}
+    UtxoServer(const UtxoServer&) = delete;
+    UtxoServer& operator=(const UtxoServer&) = delete;
+
+    ~UtxoServer() {
+        for (auto& entry : connections_) ::close(entry.first);
+        if (listen_fd_ >= 0) ::close(listen_fd_);
+        if (epoll_fd_ >= 0) ::close(epoll_fd_);
+    }
+
+    // Listens on address:port (IPv4; port 0 picks one, see port())
+    bool listen(const std::string& address, uint16_t port, std::string& error) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+            error = "bad IPv4 address " + address;
+            return false;
+        }
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        if (listen_fd_ < 0 || setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+            ::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listen_fd_, SOMAXCONN) != 0) {
+            error = address + ":" + std::to_string(port) + ": " + std::strerror(errno);
+            return false;
+        }
+        socklen_t length = sizeof(addr);
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &length);
+        port_ = ntohs(addr.sin_port);
+
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr; // the listening socket
+        if (epoll_fd_ < 0 || epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event) != 0) {
+            error = std::string("epoll: ") + std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    uint16_t port() const { return port_; }
+    size_t connection_count() const { return connections_.size(); }
+
+    void run(Handler& handler, const std::atomic<bool>& stop) {
+        epoll_event events[MAX_EVENTS];
+        std::vector<int> ready; // connections that may have responses to send
+        while (!stop.load(std::memory_order_relaxed)) {
+            int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, TICK_MS);
+            for (int i = 0; i < n; i++) {
+                Connection* connection = static_cast<Connection*>(events[i].data.ptr);
+                if (!connection) {
+                    accept_all();
+                    continue;
+                }
+                // Output already there was committed in an earlier wakeup
+                bool open = !(events[i].events & (EPOLLERR | EPOLLHUP));
+                if (open && (events[i].events & EPOLLOUT)) open = flush(*connection);
+                if (open && (events[i].events & EPOLLIN)) open = receive(*connection);
+                if (open) {
+                    serve(handler, *connection);
+                    ready.push_back(connection->fd);
+                } else {
+                    close(*connection);
+                }
+            }
+            if (!ready.empty()) {
+                bool durable = handler.commit();
+                for (int fd : ready) {
+                    auto found = connections_.find(fd);
+                    if (found == connections_.end()) continue;
+                    Connection& c = *found->second;
+                    if (!durable || !respond(c)) close(c);
+                }
+                ready.clear();
+            }
+            handler.idle();
+        }
+    }
+
+private:
+    static const int MAX_EVENTS = 64;
+    static const size_t READ_CHUNK = 64 << 10;
+
+    struct Connection {
+        int fd;
+        std::string in;
+        size_t in_offset = 0; // start of the first unhandled frame
+        std::string out;
+        size_t out_offset = 0; // start of the unsent bytes
+        bool peer_closed = false;
+        bool broken = false;   // sent a frame over MAX_BODY_BYTES
+        uint32_t events = 0;   // registered with epoll
+    };
+
+    void accept_all() {
+        for (;;) {
+            int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return; // EAGAIN, or out of descriptors until some close
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            std::unique_ptr<Connection> connection(new Connection());
+            connection->fd = fd;
+            Connection* raw = connection.get();
+            connections_[fd] = std::move(connection);
+            if (!watch(*raw, EPOLLIN, EPOLL_CTL_ADD)) close(*raw);
+        }
+    }
+
+    // Reads what is available, up to one largest frame past the handled
+    // ones (the rest waits in the socket); false on error
+    bool receive(Connection& c) {
+        while (c.in.size() - c.in_offset < FrameHeader::SIZE + FrameHeader::MAX_BODY_BYTES) {
+            ssize_t n = ::recv(c.fd, scratch_, READ_CHUNK, 0);
+            if (n > 0) {
+                c.in.append(scratch_, static_cast<size_t>(n));
+                continue;
+            }
+            if (n == 0) {
+                c.peer_closed = true; // answer what was sent, then close
+                return true;
+            }
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        return true;
+    }
+
+    // Handles the complete frames in the input buffer while the output has
+    // room; a frame larger than MAX_BODY_BYTES marks the connection broken
+    void serve(Handler& handler, Connection& c) {
+        while (c.out.size() - c.out_offset < MAX_PENDING_OUTPUT && c.in.size() - c.in_offset >= FrameHeader::SIZE) {
+            FrameHeader request = FrameHeader::read(c.in.data() + c.in_offset);
+            if (request.body_bytes > FrameHeader::MAX_BODY_BYTES) {
+                c.broken = true;
+                break;
+            }
+            size_t frame_bytes = FrameHeader::SIZE + request.body_bytes;
+            if (c.in.size() - c.in_offset < frame_bytes) break;
+            handler.handle(request, std::string_view(c.in).substr(c.in_offset + FrameHeader::SIZE, request.body_bytes), c.out);
+            c.in_offset += frame_bytes;
+        }
+        // Keep only the partial frame, if any
+        if (c.in_offset == c.in.size()) {
+            c.in.clear();
+            c.in_offset = 0;
+        } else if (c.in_offset > c.in.size() / 2) {
+            c.in.erase(0, c.in_offset);
+            c.in_offset = 0;
+        }
+    }
+
+    // True if the input buffer holds a frame serve() can act on: a complete
+    // one, or a header over MAX_BODY_BYTES
+    static bool has_frame(const Connection& c) {
+        size_t available = c.in.size() - c.in_offset;
+        if (available < FrameHeader::SIZE) return false;
+        FrameHeader request = FrameHeader::read(c.in.data() + c.in_offset);
+        return request.body_bytes > FrameHeader::MAX_BODY_BYTES || available >= FrameHeader::SIZE + request.body_bytes;
+    }
+
+    // Sends the committed output and updates the epoll interest; false to close.
+    // Frames left behind by backpressure keep EPOLLOUT registered: the peer
+    // may be waiting for their responses and send nothing more, and
+    // level-triggered epoll reports a writable socket on the next wakeup,
+    // where run() serves them.
+    bool respond(Connection& c) {
+        if (!flush(c) || c.broken) return false;
+
+        bool pending = c.out_offset < c.out.size();
+        bool waiting = has_frame(c);
+        if (c.peer_closed && !pending && !waiting) return false;
+        bool backlogged = c.out.size() - c.out_offset >= MAX_PENDING_OUTPUT;
+        uint32_t events = (backlogged || c.peer_closed ? 0 : uint32_t(EPOLLIN)) | (pending || waiting ? uint32_t(EPOLLOUT) : 0);
+        return events == c.events || watch(c, events, EPOLL_CTL_MOD);
+    }
+
+    // Sends what the socket takes; false on error
+    bool flush(Connection& c) {
+        while (c.out_offset < c.out.size()) {
+            ssize_t n = ::send(c.fd, c.out.data() + c.out_offset, c.out.size() - c.out_offset, MSG_NOSIGNAL);
+            if (n > 0) {
+                c.out_offset += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return false;
+        }
+        if (c.out_offset == c.out.size()) {
+            c.out.clear();
+            c.out_offset = 0;
+        }
+        return true;
+    }
+
+    bool watch(Connection& c, uint32_t events, int op) {
+        epoll_event event{};
+        event.events = events;
+        event.data.ptr = &c;
+        c.events = events;
+        return epoll_ctl(epoll_fd_, op, c.fd, &event) == 0;
+    }
+
+    void close(Connection& c) {
+        int fd = c.fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections_.erase(fd); // destroys c
+    }
+
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    uint16_t port_ = 0;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+    char scratch_[READ_CHUNK];
+};
+
+#endif
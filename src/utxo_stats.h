@@ -0,0 +1,289 @@
+#ifndef UTXO_STATS_H
+#define UTXO_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#include "cuckoo_insert.h"
+
+//-----------------------------------------------------------------------------
+// Hot-path event counters for a UTXO manager, and their periodic export.
+//
+// UtxoStats keeps SHARDS cache-line aligned blocks of relaxed atomic
+// counters. A thread always bumps the block chosen by its thread-local
+// shard number, so an event costs one uncontended relaxed add and threads
+// seldom share a line. Reads sum the blocks; any thread may read at any
+// time and sees every counter at some recent value.
+//
+// LatencyHistogram counts request service times in log-scale buckets (8
+// per power of two, so percentiles are within 12.5%), for front-ends such
+// as the lookup server; same relaxed-atomic rules.
+//
+// UtxoStatsSnapshot combines the counters with figures the manager keeps
+// anyway: entries (and how many sit in their alternate bucket), capacity
+// and the running load factor, and the kick path histogram of its
+// CuckooInserter, plus request latency percentiles when a histogram is
+// read in. StatsExporter writes a snapshot at most once per
+// interval: a row appended to a CSV file, and the latest snapshot as a
+// JSON object (rewritten through a temporary file). The owner polls due()
+// from its own thread, as with compaction, so the table is only read by
+// the thread that writes it.
+//-----------------------------------------------------------------------------
+
+class UtxoStats {
+public:
+    enum Counter {
+        INSERTS,         // adds that stored the entry
+        DUPLICATES,      // adds rejected because the key is present
+        INSERT_FAILURES, // adds with no eviction path
+        LOOKUPS,
+        PRIMARY_HITS,    // lookups found in the primary bucket
+        ALTERNATE_HITS,  // lookups found in the alternate bucket
+        LOOKUP_MISSES,
+        REMOVES,
+        REMOVE_MISSES,   // removes of keys that were not present
+        INVALID_KEYS,    // text keys that did not parse
+        NUM_COUNTERS
+    };
+
+    static const char* name(Counter counter) {
+        static const char* const NAMES[NUM_COUNTERS] = {"inserts", "duplicates", "insert_failures", "lookups",
+                                                        "primary_hits", "alternate_hits", "lookup_misses",
+                                                        "removes", "remove_misses", "invalid_keys"};
+        return NAMES[counter];
+    }
+
+    UtxoStats() { reset(); }
+    UtxoStats(const UtxoStats&) = delete;
+    UtxoStats& operator=(const UtxoStats&) = delete;
+
+    void add(Counter counter, uint64_t n = 1) { shards_[shard()].values[counter].fetch_add(n, std::memory_order_relaxed); }
+
+    uint64_t get(Counter counter) const {
+        uint64_t total = 0;
+        for (const Shard& s : shards_) total += s.values[counter].load(std::memory_order_relaxed);
+        return total;
+    }
+
+    void reset() {
+        for (Shard& s : shards_) {
+            for (auto& value : s.values) value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    static const size_t SHARDS = 16;
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> values[NUM_COUNTERS];
+    };
+
+    static size_t shard() {
+        static std::atomic<size_t> next_shard(0);
+        thread_local size_t s = next_shard.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+        return s;
+    }
+
+    Shard shards_[SHARDS];
+};
+
+class LatencyHistogram {
+public:
+    static const size_t SUB_BUCKETS = 8;
+    static const size_t BUCKETS = 64 * SUB_BUCKETS;
+
+    LatencyHistogram() { reset(); }
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t ns) { buckets_[bucket(ns)].fetch_add(1, std::memory_order_relaxed); }
+
+    uint64_t count() const {
+        uint64_t total = 0;
+        for (const auto& b : buckets_) total += b.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    // Upper bound of the bucket holding quantile q (0 .. 1); 0 when empty
+    uint64_t percentile(double q) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(q * (total - 1)) + 1, seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) return upper_bound(i);
+        }
+        return upper_bound(BUCKETS - 1);
+    }
+
+    void reset() {
+        for (auto& b : buckets_) b.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    // Values below SUB_BUCKETS exactly, then SUB_BUCKETS per power of two
+    static size_t bucket(uint64_t ns) {
+        if (ns < SUB_BUCKETS) return static_cast<size_t>(ns);
+        uint32_t msb = 63 - __builtin_clzll(ns);
+        return (msb - 2) * SUB_BUCKETS + ((ns >> (msb - 3)) & (SUB_BUCKETS - 1));
+    }
+    static uint64_t upper_bound(size_t i) {
+        if (i < SUB_BUCKETS) return i;
+        uint32_t msb = static_cast<uint32_t>(i / SUB_BUCKETS) + 2;
+        uint64_t sub = i % SUB_BUCKETS;
+        return ((SUB_BUCKETS + sub + 1) << (msb - 3)) - 1;
+    }
+
+    std::atomic<uint64_t> buckets_[BUCKETS];
+};
+
+struct UtxoStatsSnapshot {
+    static const size_t KICK_COLUMNS = 6; // path lengths 0 .. 4, then 5 or more
+
+    uint64_t counters[UtxoStats::NUM_COUNTERS] = {};
+    size_t entries = 0;
+    size_t alternate_entries = 0;
+    size_t capacity = 0;
+    double load_factor = 0;
+    KickHistogram kicks;
+    uint64_t requests = 0; // served by a front-end, with their service time percentiles
+    uint64_t request_p50_ns = 0;
+    uint64_t request_p99_ns = 0;
+    uint64_t request_p999_ns = 0;
+
+    void read_counters(const UtxoStats& stats) {
+        for (size_t c = 0; c < UtxoStats::NUM_COUNTERS; c++) counters[c] = stats.get(UtxoStats::Counter(c));
+    }
+
+    void read_latency(const LatencyHistogram& latency) {
+        requests = latency.count();
+        request_p50_ns = latency.percentile(0.50);
+        request_p99_ns = latency.percentile(0.99);
+        request_p999_ns = latency.percentile(0.999);
+    }
+
+    uint64_t operator[](UtxoStats::Counter counter) const { return counters[counter]; }
+
+    // Share of hits found in the alternate bucket
+    double alternate_hit_ratio() const {
+        uint64_t hits = counters[UtxoStats::PRIMARY_HITS] + counters[UtxoStats::ALTERNATE_HITS];
+        return hits ? static_cast<double>(counters[UtxoStats::ALTERNATE_HITS]) / hits : 0;
+    }
+
+    double negative_lookup_rate() const {
+        uint64_t lookups = counters[UtxoStats::LOOKUPS];
+        return lookups ? static_cast<double>(counters[UtxoStats::LOOKUP_MISSES]) / lookups : 0;
+    }
+
+    // Inserts that displaced `column` entries; the last column sums the longer paths
+    uint64_t kicks_of(size_t column) const {
+        size_t end = column + 1 < KICK_COLUMNS ? column + 1 : kicks.path_lengths.size();
+        uint64_t total = 0;
+        for (size_t i = column; i < end && i < kicks.path_lengths.size(); i++) total += kicks.path_lengths[i];
+        return total;
+    }
+
+    static void write_csv_header(std::ostream& out) {
+        for (size_t c = 0; c < UtxoStats::NUM_COUNTERS; c++) out << UtxoStats::name(UtxoStats::Counter(c)) << ",";
+        out << "entries,alternate_entries,capacity,load_factor,alternate_hit_ratio,negative_lookup_rate";
+        for (size_t k = 0; k < KICK_COLUMNS; k++) out << ",kicks_" << k << (k == KICK_COLUMNS - 1 ? "_plus" : "");
+        out << ",requests,request_p50_ns,request_p99_ns,request_p999_ns\n";
+    }
+
+    void write_csv_row(std::ostream& out) const {
+        for (uint64_t value : counters) out << value << ",";
+        out << entries << "," << alternate_entries << "," << capacity << "," << load_factor << "," << alternate_hit_ratio() << ","
+            << negative_lookup_rate();
+        for (size_t k = 0; k < KICK_COLUMNS; k++) out << "," << kicks_of(k);
+        out << "," << requests << "," << request_p50_ns << "," << request_p99_ns << "," << request_p999_ns << "\n";
+    }
+
+    void write_json(std::ostream& out) const {
+        out << "{";
+        for (size_t c = 0; c < UtxoStats::NUM_COUNTERS; c++) {
+            out << "\"" << UtxoStats::name(UtxoStats::Counter(c)) << "\": " << counters[c] << ", ";
+        }
+        out << "\"entries\": " << entries << ", \"alternate_entries\": " << alternate_entries
+            << ", \"capacity\": " << capacity << ", \"load_factor\": " << load_factor
+            << ", \"alternate_hit_ratio\": " << alternate_hit_ratio()
+            << ", \"negative_lookup_rate\": " << negative_lookup_rate() << ", \"kick_path_lengths\": [";
+        for (size_t i = 0; i < kicks.path_lengths.size(); i++) out << (i ? ", " : "") << kicks.path_lengths[i];
+        out << "], \"requests\": " << requests << ", \"request_p50_ns\": " << request_p50_ns
+            << ", \"request_p99_ns\": " << request_p99_ns << ", \"request_p999_ns\": " << request_p999_ns << "}";
+    }
+};
+
+class StatsExporter {
+public:
+    static constexpr std::chrono::seconds DEFAULT_INTERVAL{10};
+
+    // Appends to `csv_path` (header first if new) and rewrites `json_path`;
+    // either may be empty to skip it. A CSV whose header differs, e.g. from
+    // a build with other columns, is renamed to "<csv_path>.old" and a new
+    // one started. False if the CSV cannot be opened.
+    bool open(const std::string& csv_path, const std::string& json_path,
+              std::chrono::steady_clock::duration interval = DEFAULT_INTERVAL) {
+        json_path_ = json_path;
+        interval_ = interval;
+        started_ = last_ = std::chrono::steady_clock::now();
+        if (csv_path.empty()) return true;
+        std::ostringstream header;
+        header << "seconds,";
+        UtxoStatsSnapshot::write_csv_header(header);
+
+        bool fresh = true;
+        {
+            std::ifstream existing(csv_path);
+            std::string first_line;
+            if (existing.good()) {
+                fresh = !std::getline(existing, first_line);
+                if (!fresh && first_line + "\n" != header.str()) {
+                    existing.close();
+                    if (std::rename(csv_path.c_str(), (csv_path + ".old").c_str()) != 0) return false;
+                    fresh = true;
+                }
+            }
+        }
+        csv_.open(csv_path, std::ios::app);
+        if (!csv_) return false;
+        if (fresh) csv_ << header.str();
+        return true;
+    }
+
+    bool due() const { return std::chrono::steady_clock::now() - last_ >= interval_; }
+
+    void write(const UtxoStatsSnapshot& snapshot) {
+        last_ = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(last_ - started_).count();
+        if (csv_.is_open()) {
+            csv_ << seconds << ",";
+            snapshot.write_csv_row(csv_);
+            csv_.flush();
+        }
+        if (!json_path_.empty()) {
+            std::string tmp = json_path_ + ".tmp";
+            {
+                std::ofstream json(tmp, std::ios::trunc);
+                json << "{\"seconds\": " << seconds << ", \"stats\": ";
+                snapshot.write_json(json);
+                json << "}\n";
+            }
+            std::rename(tmp.c_str(), json_path_.c_str());
+        }
+    }
+
+private:
+    std::ofstream csv_;
+    std::string json_path_;
+    std::chrono::steady_clock::duration interval_ = DEFAULT_INTERVAL;
+    std::chrono::steady_clock::time_point started_, last_;
+};
+
+#endif
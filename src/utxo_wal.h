@@ -0,0 +1,361 @@
+#ifndef UTXO_WAL_H
+#define UTXO_WAL_H
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "crc.h"
+
+//-----------------------------------------------------------------------------
+// Write-ahead log of UTXO changes, between two snapshots.
+//
+// An append-only file of records, each
+//
+//   u32 body length | u32 crc32(body) | body
+//   body = u64 sequence | u8 type | u32 key hash | encoded value (ADD only)
+//
+// keyed by hash like the table, with values in their compact encoding, so
+// replaying a record is one insert or erase. Sequence numbers increase by
+// one per record across log files; a snapshot records the last sequence it
+// contains and replay skips everything up to it.
+//
+// Group commit: append() only copies the record into a memory buffer. A
+// flusher thread writes the whole buffer with one write() and one
+// fdatasync() whenever it is non-empty, at most every commit_interval, so
+// concurrent or back-to-back appends share a flush and the caller never
+// waits for the disk unless it asks to (wait_durable()).
+//
+// Compaction: rotate() moves the log aside to "<path>.old" and starts an
+// empty one; once a snapshot holding everything up to the rotation is
+// durable, finish_rotation() deletes the old file. Recovery replays
+// "<path>.old" (if a compaction did not finish) and then "<path>". A torn
+// record at the end of either log (crash mid-write or mid-rotation) ends
+// its replay, and open() cuts both back to their valid prefix, so records
+// appended later stay reachable.
+//-----------------------------------------------------------------------------
+
+class WriteAheadLog {
+public:
+    enum RecordType : uint8_t { ADD = 1, REMOVE = 2 };
+
+    static const size_t HEADER_BYTES = 8;                 // length + crc
+    static const size_t BODY_FIXED_BYTES = 8 + 1 + 4;     // sequence + type + hash
+    static const uint32_t MAX_BODY_BYTES = 1u << 24;
+    static constexpr std::chrono::milliseconds DEFAULT_COMMIT_INTERVAL{2};
+
+    struct ReplayResult {
+        size_t records = 0;       // well-formed records read
+        size_t applied = 0;       // of those, newer than after_sequence and applied
+        size_t refused = 0;       // newer than after_sequence, but fn could not apply them
+        uint64_t last_sequence = 0;
+        uint64_t valid_bytes = 0; // file prefix holding whole records
+    };
+
+    WriteAheadLog() {}
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+    ~WriteAheadLog() { close(); }
+
+    // Opens `path` for appending (creating it), cutting it to valid_bytes
+    // and a leftover "<path>.old" to old_valid_bytes first (the valid_bytes
+    // of their replays); new records are numbered from next_sequence
+    bool open(const std::string& path, uint64_t valid_bytes, uint64_t old_valid_bytes, uint64_t next_sequence,
+              std::string& error, std::chrono::milliseconds commit_interval = DEFAULT_COMMIT_INTERVAL) {
+        close();
+        if (!truncate_old(old_path(path), old_valid_bytes, error) || !open_file(path, valid_bytes, error)) return false;
+        path_ = path;
+        commit_interval_ = commit_interval;
+        next_sequence_ = next_sequence;
+        durable_sequence_ = next_sequence - 1;
+        records_since_rotation_ = 0;
+        stop_ = false;
+        failed_ = false;
+        flusher_ = std::thread([this]() { flush_loop(); });
+        return true;
+    }
+
+    bool is_open() const { return fd_ >= 0; }
+
+    // Returns the record's sequence number
+    uint64_t append_add(uint32_t hash, std::string_view encoded) { return append(ADD, hash, encoded); }
+    uint64_t append_remove(uint32_t hash) { return append(REMOVE, hash, std::string_view()); }
+
+    // Blocks until every record up to `sequence` is on disk; false if a
+    // write failed
+    bool wait_durable(uint64_t sequence) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.notify_one();
+        durable_.wait(lock, [&]() { return durable_sequence_ >= sequence || failed_; });
+        return !failed_;
+    }
+
+    bool flush() {
+        uint64_t last;
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            last = next_sequence_ - 1;
+        }
+        return wait_durable(last);
+    }
+
+    uint64_t last_sequence() const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return next_sequence_ - 1;
+    }
+
+    size_t records_since_rotation() const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return records_since_rotation_;
+    }
+
+    // Flushes, then moves the log to "<path>.old" (appending to it if an
+    // earlier compaction never finished) and continues in a new file; the
+    // directory is synced so the move survives a crash
+    bool rotate(std::string& error) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.notify_one();
+        durable_.wait(lock, [&]() { return (buffer_.empty() && !writing_) || failed_; });
+        if (failed_) {
+            error = path_ + ": write failed";
+            return false;
+        }
+        std::string old = old_path(path_);
+        struct stat st;
+        if (stat(old.c_str(), &st) == 0) {
+            if (!append_file(path_, old, error)) return false;
+        } else if (std::rename(path_.c_str(), old.c_str()) != 0) {
+            error = old + ": " + std::strerror(errno);
+            return false;
+        }
+        ::close(fd_);
+        fd_ = -1;
+        if (!open_file(path_, 0, error) || !sync_directory(path_, error)) return false;
+        records_since_rotation_ = 0;
+        return true;
+    }
+
+    // The snapshot taken at the last rotate() is durable
+    void finish_rotation() { std::remove(old_path(path_).c_str()); }
+
+    void close() {
+        if (!flusher_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        flusher_.join();
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    static std::string old_path(const std::string& path) { return path + ".old"; }
+
+    // Calls fn(type, sequence, hash, encoded) for each record of `path`
+    // newer than after_sequence, in order; fn returns false for a record it
+    // could not apply. A missing file is an empty log.
+    template <typename Fn>
+    static bool replay(const std::string& path, uint64_t after_sequence, Fn fn, ReplayResult& result,
+                       std::string& error) {
+        result = ReplayResult();
+        result.last_sequence = after_sequence;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            if (errno == ENOENT) return true;
+            error = path + ": " + std::strerror(errno);
+            return false;
+        }
+        std::vector<char> data;
+        char chunk[1 << 16];
+        for (;;) {
+            ssize_t n = ::read(fd, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                error = path + ": " + std::strerror(errno);
+                ::close(fd);
+                return false;
+            }
+            if (n == 0) break;
+            data.insert(data.end(), chunk, chunk + n);
+        }
+        ::close(fd);
+
+        size_t pos = 0;
+        while (data.size() - pos >= HEADER_BYTES) {
+            uint32_t length, crc;
+            std::memcpy(&length, &data[pos], 4);
+            std::memcpy(&crc, &data[pos + 4], 4);
+            if (length < BODY_FIXED_BYTES || length > MAX_BODY_BYTES || data.size() - pos - HEADER_BYTES < length) break;
+            const char* body = &data[pos + HEADER_BYTES];
+            if (crc32(body, static_cast<int>(length), 0) != crc) break;
+            uint64_t sequence;
+            uint32_t hash;
+            std::memcpy(&sequence, body, 8);
+            uint8_t type = static_cast<uint8_t>(body[8]);
+            std::memcpy(&hash, body + 9, 4);
+            if (type != ADD && type != REMOVE) break;
+            pos += HEADER_BYTES + length;
+            result.records++;
+            if (sequence > after_sequence) {
+                if (fn(static_cast<RecordType>(type), sequence, hash,
+                       std::string_view(body + BODY_FIXED_BYTES, length - BODY_FIXED_BYTES))) {
+                    result.applied++;
+                } else {
+                    result.refused++;
+                }
+                result.last_sequence = sequence;
+            }
+        }
+        result.valid_bytes = pos;
+        return true;
+    }
+
+private:
+    uint64_t append(RecordType type, uint32_t hash, std::string_view encoded) {
+        uint32_t length = static_cast<uint32_t>(BODY_FIXED_BYTES + encoded.size());
+        std::lock_guard<std::mutex> guard(mutex_);
+        uint64_t sequence = next_sequence_++;
+        size_t start = buffer_.size();
+        buffer_.resize(start + HEADER_BYTES + length);
+        char* record = &buffer_[start];
+        char* body = record + HEADER_BYTES;
+        std::memcpy(body, &sequence, 8);
+        body[8] = static_cast<char>(type);
+        std::memcpy(body + 9, &hash, 4);
+        if (!encoded.empty()) std::memcpy(body + BODY_FIXED_BYTES, encoded.data(), encoded.size());
+        uint32_t crc = crc32(body, static_cast<int>(length), 0);
+        std::memcpy(record, &length, 4);
+        std::memcpy(record + 4, &crc, 4);
+        records_since_rotation_++;
+        wake_.notify_one();
+        return sequence;
+    }
+
+    // Flusher thread: one write + fdatasync per group of buffered records
+    void flush_loop() {
+        std::vector<char> batch;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            wake_.wait(lock, [&]() { return stop_ || !buffer_.empty(); });
+            if (buffer_.empty() && stop_) return;
+            batch.swap(buffer_);
+            uint64_t last = next_sequence_ - 1;
+            int fd = fd_;
+            writing_ = true;
+            lock.unlock();
+
+            bool ok = write_all(fd, batch.data(), batch.size()) && ::fdatasync(fd) == 0;
+            batch.clear();
+            auto next_commit = std::chrono::steady_clock::now() + commit_interval_;
+
+            lock.lock();
+            writing_ = false;
+            if (ok) {
+                durable_sequence_ = last;
+            } else {
+                failed_ = true;
+            }
+            durable_.notify_all();
+            // Let more records gather before the next flush
+            if (!stop_) wake_.wait_until(lock, next_commit, [&]() { return stop_; });
+        }
+    }
+
+    bool open_file(const std::string& path, uint64_t valid_bytes, std::string& error) {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd_ < 0 || ::ftruncate(fd_, static_cast<off_t>(valid_bytes)) != 0 ||
+            ::lseek(fd_, 0, SEEK_END) < 0) {
+            error = path + ": " + std::strerror(errno);
+            if (fd_ >= 0) ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        return true;
+    }
+
+    // Cuts a leftover rotated log to its valid prefix; a missing one is fine
+    static bool truncate_old(const std::string& path, uint64_t valid_bytes, std::string& error) {
+        int fd = ::open(path.c_str(), O_WRONLY);
+        if (fd < 0 && errno == ENOENT) return true;
+        bool ok = fd >= 0 && ::ftruncate(fd, static_cast<off_t>(valid_bytes)) == 0 && ::fsync(fd) == 0;
+        if (!ok) error = path + ": " + std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return ok;
+    }
+
+    // Makes the renames and creations in the directory of `path` durable
+    static bool sync_directory(const std::string& path, std::string& error) {
+        size_t slash = path.rfind('/');
+        std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+        bool ok = fd >= 0 && ::fsync(fd) == 0;
+        if (!ok) error = directory + ": " + std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return ok;
+    }
+
+    // Appends the contents of `from` to `to`, then removes `from`
+    static bool append_file(const std::string& from, const std::string& to, std::string& error) {
+        int in = ::open(from.c_str(), O_RDONLY);
+        int out = ::open(to.c_str(), O_WRONLY | O_APPEND);
+        bool ok = in >= 0 && out >= 0;
+        char chunk[1 << 16];
+        while (ok) {
+            ssize_t n = ::read(in, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                ok = n == 0;
+                break;
+            }
+            ok = write_all(out, chunk, static_cast<size_t>(n));
+        }
+        ok = ok && ::fsync(out) == 0;
+        if (!ok) error = to + ": " + std::strerror(errno);
+        if (in >= 0) ::close(in);
+        if (out >= 0) ::close(out);
+        if (ok) std::remove(from.c_str());
+        return ok;
+    }
+
+    static bool write_all(int fd, const char* data, size_t bytes) {
+        while (bytes > 0) {
+            ssize_t n = ::write(fd, data, bytes);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            bytes -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    std::chrono::milliseconds commit_interval_ = DEFAULT_COMMIT_INTERVAL;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;    // records buffered, or stop
+    std::condition_variable durable_; // durable_sequence_ moved
+    std::vector<char> buffer_;        // appended, not yet written
+    uint64_t next_sequence_ = 1;
+    uint64_t durable_sequence_ = 0;
+    size_t records_since_rotation_ = 0;
+    bool writing_ = false; // flusher is writing a batch outside the lock
+    bool stop_ = false;
+    bool failed_ = false;
+    std::thread flusher_;
+};
+
+#endif
@@ -0,0 +1,363 @@
+#ifndef VALUE_SLAB_H
+#define VALUE_SLAB_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "memory_policy.h"
+
+//-----------------------------------------------------------------------------
+// Arena-backed UTXO value store.
+//
+// The cuckoo table keeps only a 32-bit slab index per slot, so kicks move
+// four bytes instead of a whole value. Each index names one fixed-size
+// slab record, a byte span in a shared bump-allocated arena holding the
+// value's compact encoding (src/utxo_codec.h). Freed records go on a
+// free-list. Freed arena spans are kept on per-length free-lists (encoded
+// values of standard outputs come in a handful of sizes, so they are
+// reused almost exactly); spans longer than MAX_REUSED_SPAN are left as
+// dead bytes.
+//
+// A lookup is the two table probes plus one slab access. The views
+// returned by get() stay valid until the value is released or the next
+// add(). The record array and arena are allocated under a MemoryPolicy
+// (src/memory_policy.h), by default plain operator new.
+//
+// A record packs a 40-bit arena offset and a 24-bit length into 8 bytes,
+// so the arena may grow to MAX_ARENA_BYTES (1 TiB, far beyond the ~4.5 GB
+// of a full chainstate) and a value may be up to MAX_VALUE_BYTES long.
+// add() returns NO_INDEX for a value past either limit, or once the 32-bit
+// indexes run out.
+//-----------------------------------------------------------------------------
+
+struct ByteSpan {
+    uint64_t offset : 40;
+    uint64_t length : 24;
+};
+
+static_assert(sizeof(ByteSpan) == 8, "slab records are stored in snapshots as 8 bytes");
+
+class ValueSlab {
+public:
+    static const uint32_t MAX_REUSED_SPAN = 128;
+    static const uint64_t MAX_ARENA_BYTES = uint64_t(1) << 40;
+    static const uint32_t MAX_VALUE_BYTES = (1u << 24) - 1;
+    static const uint32_t NO_INDEX = UINT32_MAX;
+
+    ValueSlab() {}
+
+    explicit ValueSlab(const MemoryPolicy& memory)
+        : records_(PolicyAllocator<ByteSpan>(memory)), arena_(PolicyAllocator<char>(memory)) {}
+
+    // Starts from `num_records` records and `arena_bytes` of arena laid out
+    // as written by for_each_record_block() / for_each_arena_block(), e.g.
+    // in a mapped snapshot, used in place; new values go to owned memory
+    // after them. Holes in the borrowed records are not reused.
+    ValueSlab(ByteSpan* records, size_t num_records, char* arena, size_t arena_bytes, size_t live, size_t dead_bytes)
+        : base_records_(records), base_record_count_(num_records), base_arena_(arena), base_arena_bytes_(arena_bytes),
+          dead_bytes_(dead_bytes), live_(live) {}
+
+    // Copies `encoded` into the arena; NO_INDEX if it does not fit (see above)
+    uint32_t add(std::string_view encoded) {
+        if (free_records_.empty() && record_count() >= NO_INDEX) return NO_INDEX;
+        ByteSpan span;
+        if (!store(encoded, span)) return NO_INDEX;
+        uint32_t index;
+        if (!free_records_.empty()) {
+            index = free_records_.back();
+            free_records_.pop_back();
+            record(index) = span;
+        } else {
+            index = static_cast<uint32_t>(base_record_count_ + records_.size());
+            records_.push_back(span);
+        }
+        live_++;
+        return index;
+    }
+
+    void release(uint32_t index) {
+        free_span(record(index));
+        record(index) = ByteSpan{0, 0};
+        free_records_.push_back(index);
+        live_--;
+    }
+
+    std::string_view get(uint32_t index) const {
+        const ByteSpan& span = record(index);
+        return std::string_view(arena_at(span.offset), span.length);
+    }
+
+    // Starts loading the value's bytes ahead of get()
+    void prefetch(uint32_t index) const { __builtin_prefetch(arena_at(record(index).offset)); }
+
+    size_t size() const { return live_; }
+    size_t record_count() const { return base_record_count_ + records_.size(); }
+    size_t arena_bytes() const { return base_arena_bytes_ + arena_.size(); }
+    size_t dead_bytes() const { return dead_bytes_; }
+
+    // Owned memory only (borrowed records and arena are not counted)
+    size_t memory_bytes() const {
+        size_t bytes = records_.capacity() * sizeof(ByteSpan) + free_records_.capacity() * sizeof(uint32_t) +
+                       arena_.capacity();
+        for (const auto& list : free_spans_) bytes += list.capacity() * sizeof(uint64_t);
+        return bytes;
+    }
+
+    // fn(data, bytes) over the record array, then the arena, in order; their
+    // concatenation is what the borrowing constructor takes
+    template <typename Fn>
+    void for_each_record_block(Fn fn) const {
+        if (base_record_count_) fn(reinterpret_cast<const char*>(base_records_), base_record_count_ * sizeof(ByteSpan));
+        if (!records_.empty()) fn(reinterpret_cast<const char*>(records_.data()), records_.size() * sizeof(ByteSpan));
+    }
+
+    template <typename Fn>
+    void for_each_arena_block(Fn fn) const {
+        if (base_arena_bytes_) fn(base_arena_, base_arena_bytes_);
+        if (!arena_.empty()) fn(arena_.data(), arena_.size());
+    }
+
+private:
+    ByteSpan& record(uint32_t index) {
+        return index < base_record_count_ ? base_records_[index] : records_[index - base_record_count_];
+    }
+    const ByteSpan& record(uint32_t index) const {
+        return index < base_record_count_ ? base_records_[index] : records_[index - base_record_count_];
+    }
+
+    char* arena_at(uint64_t offset) {
+        return offset < base_arena_bytes_ ? base_arena_ + offset : arena_.data() + (offset - base_arena_bytes_);
+    }
+    const char* arena_at(uint64_t offset) const {
+        return offset < base_arena_bytes_ ? base_arena_ + offset : arena_.data() + (offset - base_arena_bytes_);
+    }
+
+    // Sets `span` to a copy of `bytes`; false past the size limits
+    bool store(std::string_view bytes, ByteSpan& span) {
+        if (bytes.size() > MAX_VALUE_BYTES) return false;
+        uint32_t length = static_cast<uint32_t>(bytes.size());
+        span = ByteSpan{0, length};
+        if (length == 0) return true;
+        if (length < free_spans_.size() && !free_spans_[length].empty()) {
+            span.offset = free_spans_[length].back();
+            free_spans_[length].pop_back();
+            dead_bytes_ -= length;
+        } else {
+            if (arena_bytes() + length > MAX_ARENA_BYTES) return false;
+            span.offset = arena_bytes();
+            arena_.resize(arena_.size() + length);
+        }
+        std::memcpy(arena_at(span.offset), bytes.data(), length);
+        return true;
+    }
+
+    void free_span(ByteSpan span) {
+        if (span.length == 0) return;
+        dead_bytes_ += span.length;
+        if (span.length > MAX_REUSED_SPAN) return;
+        if (span.length >= free_spans_.size()) free_spans_.resize(span.length + 1);
+        free_spans_[span.length].push_back(span.offset);
+    }
+
+    ByteSpan* base_records_ = nullptr; // borrowed, indexes [0, base_record_count_)
+    size_t base_record_count_ = 0;
+    char* base_arena_ = nullptr;       // borrowed, offsets [0, base_arena_bytes_)
+    size_t base_arena_bytes_ = 0;
+    std::vector<ByteSpan, PolicyAllocator<ByteSpan>> records_;
+    std::vector<uint32_t> free_records_;
+    std::vector<char, PolicyAllocator<char>> arena_;
+    std::vector<std::vector<uint64_t>> free_spans_; // arena offsets, indexed by span length
+    size_t dead_bytes_ = 0;
+    size_t live_ = 0;
+};
+
+//-----------------------------------------------------------------------------
+// Thread-safe variant for ConcurrentPcfTable.
+//
+// Split into SHARDS independent slabs, each with its own mutex, chosen by
+// a caller hint (the key hash): writers on different shards never meet.
+// Records and arena bytes live in fixed-size segments reached through
+// fixed directories, so nothing is ever moved and read() needs no lock:
+// it loads the record word (segment, offset and length in one atomic) and
+// copies the bytes. As with the table, a read racing a release of the
+// same index may copy garbage; callers run read() inside the table's
+// validated section and release an index only after the entry referring
+// to it has been erased.
+//
+// Index layout: local record number << SHARD_BITS | shard.
+//-----------------------------------------------------------------------------
+
+class ConcurrentValueSlab {
+public:
+    static const uint32_t SHARD_BITS = 6;
+    static const uint32_t SHARDS = 1u << SHARD_BITS;
+    static const uint32_t RECORD_SEGMENT_BITS = 16;
+    static const uint32_t MAX_RECORD_SEGMENTS = 1u << (32 - SHARD_BITS - RECORD_SEGMENT_BITS);
+    static const uint32_t ARENA_SEGMENT_BITS = 20;
+    static const uint32_t MAX_ARENA_SEGMENTS = 4096;
+    static const uint32_t MAX_VALUE_BYTES = 1u << ARENA_SEGMENT_BITS;
+    static const uint32_t MAX_REUSED_SPAN = ValueSlab::MAX_REUSED_SPAN;
+    static const uint32_t NO_INDEX = UINT32_MAX;
+
+    ConcurrentValueSlab() : shards_(new Shard[SHARDS]) {}
+
+    // Copies `encoded` into the shard picked by `hint`; NO_INDEX if that
+    // shard is out of records or the value is larger than a segment
+    uint32_t add(std::string_view encoded, uint32_t hint) {
+        if (encoded.size() >= MAX_VALUE_BYTES) return NO_INDEX;
+        uint32_t shard_index = hint & (SHARDS - 1);
+        Shard& shard = shards_[shard_index];
+        std::lock_guard<std::mutex> guard(shard.mutex);
+
+        if (shard.free_records.empty() && (shard.num_records >> RECORD_SEGMENT_BITS) >= MAX_RECORD_SEGMENTS) {
+            return NO_INDEX;
+        }
+        uint64_t packed;
+        if (!store(shard, encoded, packed)) return NO_INDEX;
+
+        uint32_t local;
+        if (!shard.free_records.empty()) {
+            local = shard.free_records.back();
+            shard.free_records.pop_back();
+        } else {
+            local = shard.num_records++;
+            std::atomic<std::atomic<uint64_t>*>& segment = shard.records[local >> RECORD_SEGMENT_BITS];
+            if (!segment.load(std::memory_order_relaxed)) {
+                std::atomic<uint64_t>* block = new std::atomic<uint64_t>[size_t(1) << RECORD_SEGMENT_BITS];
+                for (size_t i = 0; i < (size_t(1) << RECORD_SEGMENT_BITS); i++) block[i].store(0, std::memory_order_relaxed);
+                segment.store(block, std::memory_order_release);
+            }
+        }
+        record(shard, local).store(packed, std::memory_order_release);
+        shard.live++;
+        return local << SHARD_BITS | shard_index;
+    }
+
+    void release(uint32_t index) {
+        Shard& shard = shards_[index & (SHARDS - 1)];
+        uint32_t local = index >> SHARD_BITS;
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        std::atomic<uint64_t>& word = record(shard, local);
+        uint64_t packed = word.load(std::memory_order_relaxed);
+        word.store(0, std::memory_order_relaxed);
+        uint32_t length = packed_length(packed);
+        if (length > 0) {
+            shard.dead_bytes += length;
+            if (length <= MAX_REUSED_SPAN) {
+                if (length >= shard.free_spans.size()) shard.free_spans.resize(length + 1);
+                shard.free_spans[length].push_back(packed >> ARENA_SEGMENT_BITS);
+            }
+        }
+        shard.free_records.push_back(local);
+        shard.live--;
+    }
+
+    // Lock-free copy of the value at `index` into `out`; false for an
+    // index that was never handed out
+    bool read(uint32_t index, std::string& out) const {
+        const Shard& shard = shards_[index & (SHARDS - 1)];
+        uint32_t local = index >> SHARD_BITS;
+        const std::atomic<uint64_t>* block =
+            shard.records[local >> RECORD_SEGMENT_BITS].load(std::memory_order_acquire);
+        if (!block) return false;
+        uint64_t packed = block[local & ((1u << RECORD_SEGMENT_BITS) - 1)].load(std::memory_order_acquire);
+        uint32_t length = packed_length(packed);
+        uint64_t segment = packed >> (2 * ARENA_SEGMENT_BITS);
+        uint32_t offset = static_cast<uint32_t>(packed >> ARENA_SEGMENT_BITS) & (MAX_VALUE_BYTES - 1);
+        const char* bytes = segment < MAX_ARENA_SEGMENTS ? shard.arena[segment].load(std::memory_order_acquire) : nullptr;
+        if (!bytes || offset + length > MAX_VALUE_BYTES) {
+            out.clear();
+            return length == 0;
+        }
+        out.assign(bytes + offset, length);
+        return true;
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (uint32_t i = 0; i < SHARDS; i++) {
+            std::lock_guard<std::mutex> guard(shards_[i].mutex);
+            total += shards_[i].live;
+        }
+        return total;
+    }
+
+    size_t memory_bytes() const {
+        size_t bytes = SHARDS * sizeof(Shard);
+        for (uint32_t i = 0; i < SHARDS; i++) {
+            const Shard& shard = shards_[i];
+            std::lock_guard<std::mutex> guard(shard.mutex);
+            size_t record_segments = (shard.num_records + (1u << RECORD_SEGMENT_BITS) - 1) >> RECORD_SEGMENT_BITS;
+            bytes += record_segments * (sizeof(std::atomic<uint64_t>) << RECORD_SEGMENT_BITS);
+            bytes += shard.arena_segments * size_t(MAX_VALUE_BYTES);
+            bytes += shard.free_records.capacity() * sizeof(uint32_t);
+            for (const auto& list : shard.free_spans) bytes += list.capacity() * sizeof(uint64_t);
+        }
+        return bytes;
+    }
+
+private:
+    // Record word: arena segment (20 bits) | offset (20 bits) | length (20 bits)
+    struct Shard {
+        mutable std::mutex mutex;
+        std::atomic<std::atomic<uint64_t>*> records[MAX_RECORD_SEGMENTS] = {};
+        std::unique_ptr<std::atomic<char*>[]> arena{new std::atomic<char*>[MAX_ARENA_SEGMENTS]()};
+        uint32_t num_records = 0;
+        uint32_t arena_segments = 0;
+        uint32_t arena_used = MAX_VALUE_BYTES; // bytes used in the last segment
+        std::vector<uint32_t> free_records;
+        std::vector<std::vector<uint64_t>> free_spans; // segment << 20 | offset, indexed by span length
+        size_t dead_bytes = 0;
+        size_t live = 0;
+
+        ~Shard() {
+            for (auto& block : records) delete[] block.load(std::memory_order_relaxed);
+            for (uint32_t i = 0; i < arena_segments; i++) delete[] arena[i].load(std::memory_order_relaxed);
+        }
+    };
+
+    static uint32_t packed_length(uint64_t packed) { return static_cast<uint32_t>(packed) & (MAX_VALUE_BYTES - 1); }
+
+    static std::atomic<uint64_t>& record(const Shard& shard, uint32_t local) {
+        std::atomic<uint64_t>* block = shard.records[local >> RECORD_SEGMENT_BITS].load(std::memory_order_relaxed);
+        return block[local & ((1u << RECORD_SEGMENT_BITS) - 1)];
+    }
+
+    // Copies `bytes` into the shard's arena; `packed` gets the record word.
+    // False once the shard's arena directory is exhausted.
+    bool store(Shard& shard, std::string_view bytes, uint64_t& packed) {
+        uint64_t length = bytes.size();
+        packed = 0;
+        if (length == 0) return true;
+        uint64_t location;
+        if (length < shard.free_spans.size() && !shard.free_spans[length].empty()) {
+            location = shard.free_spans[length].back();
+            shard.free_spans[length].pop_back();
+            shard.dead_bytes -= length;
+        } else {
+            if (shard.arena_used + length > MAX_VALUE_BYTES) {
+                if (shard.arena_segments == MAX_ARENA_SEGMENTS) return false;
+                shard.arena[shard.arena_segments].store(new char[MAX_VALUE_BYTES], std::memory_order_release);
+                shard.arena_segments++;
+                shard.arena_used = 0;
+            }
+            location = uint64_t(shard.arena_segments - 1) << ARENA_SEGMENT_BITS | shard.arena_used;
+            shard.arena_used += static_cast<uint32_t>(length);
+        }
+        char* segment = shard.arena[location >> ARENA_SEGMENT_BITS].load(std::memory_order_relaxed);
+        std::memcpy(segment + (location & (MAX_VALUE_BYTES - 1)), bytes.data(), length);
+        packed = location << ARENA_SEGMENT_BITS | length;
+        return true;
+    }
+
+    std::unique_ptr<Shard[]> shards_;
+};
+
+#endif